@@ -1,19 +1,48 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "verhoeff_batch.h"
 
 typedef enum{FAILURE,SUCCESS}                                               status_code;
 typedef enum{NULL_KEY,MONTHS,SELLER_ID,BUYER_ID,UNIQUE_PAIR_ID,ENERGY,TIME} key        ;  
+typedef enum{BITMAP_LOOKUP,HASH_INDEX_LOOKUP}                               uniqueness_mode;
+typedef enum{PAIRS_BY_TRANSACTIONS,PAIRS_BY_REVENUE,SELLERS_BY_REVENUE,RANKING_COUNT} ranking;
  
 
-#define HASH_TABLE_SIZE           100003 // A large prime number for better distribution
+#define HASH_INDEX_FIRST_CAPACITY 1024  // slots of a hash index at its first insert, always a power of two
 #define MAX_LINE_LENGTH           100
 #define MIN_INPUT_NO              100000
 #define MAX_INPUT_NO              999999
 #define FREQUENT_BUYING_THRESHOLD 5 
 #define MIN_YEAR                  1950
 #define MAX_YEAR                  2050
+#define SLAB_FIRST_CHUNK_NODES    256   // nodes in the first chunk of every slab
+#define SLAB_MAX_CHUNK_NODES      65536 // chunks double in size up to this many nodes
+#define TID_BITMAP_WORDS          ((MAX_INPUT_NO - MIN_INPUT_NO + 1 + 63) / 64) // one bit per possible transaction ID
+#define TIME_INDEX_FIRST_CAPACITY 1024  // entries of the time index at its first insert
+#define ENERGY_INDEX_MAX_LEVEL    12    // levels of the energy skip list, plenty for 4^12 = 16M records
+#define BULK_LOAD_BUFFER_SIZE     (1 << 20) // bytes read from a load file at once
+#define BULK_LOAD_BATCH_ROWS      4096  // parsed rows that are validated and inserted together
+#define WAL_BUFFER_SIZE           65536 // bytes of log entries collected before they are written out
+#define WAL_DEFAULT_SYNC_BYTES    65536 // log bytes after which a group commit is forced
+#define WAL_DEFAULT_SYNC_MS       100   // milliseconds after which a group commit is forced
+#define RADIX_BITS                8     // bits of the key sorted by one pass of the radix sort
+#define NATURAL_MERGE_MAX_RUNS    4     // lists with at most this many runs are merged instead of radix sorted
+#define COLUMN_INITIAL_CAPACITY   1024  // rows of the columnar store before its first growth
+#define COLUMN_LANES              8     // independent accumulators of the columnar scans
+#define VALID_ID_COUNT            ((MAX_INPUT_NO - MIN_INPUT_NO + 1) / 10) // IDs with a valid check digit, one per 5 digit prefix
+#define BENCHMARK_CHUNK_ROWS      65536 // synthetic transactions generated before each timed insert loop
 
 typedef struct time_and_date_of_the_transaction
 {
@@ -33,9 +62,8 @@ typedef struct Energy_record_node_tag
     float          energy_amount               ;
     float          price_per_unit              ;
     float          transaction_money           ;
-    unsigned long  unique_pair_id              ; 
-    unsigned long  transaction_hash            ;
-    time_stamp     time                        ;
+    uint64_t       unique_pair_id              ;//pair_key of the seller and buyer
+    uint32_t       packed_time                 ;//time of the transaction packed by pack_time_stamp
     struct Energy_record_node_tag *next_record ;
 }Record;
 //structure declaration for the node of each transaction Record
@@ -62,7 +90,7 @@ typedef struct Seller_tag
 
 typedef struct Unique_pair_tag
 {
-    unsigned long upid       ;//uniquepairID
+    uint64_t      upid       ;//uniquepairID, pair_key of SID and BID
     int           SID        ;//Seller ID
     int           BID        ;//Buyer ID
     int           NOT        ;//Number of transactions
@@ -71,12 +99,244 @@ typedef struct Unique_pair_tag
 }Pair;
 //structues to store attributes of uniquepairs
 
-typedef struct transaction_hash_node {
-    int           id       ; // 5 digits transaction ID is enough
-    unsigned long hashValue; // Store the hash value
-    struct transaction_hash_node* next;
-} transaction_hash_node;
-//structure that will be chained as the linked list in the hash function in the Hashtable array
+typedef struct Hash_slot_tag
+{
+    uint64_t      key  ;//0 marks an empty slot, every ID and pair key we store is nonzero
+    void*         node ;//handle stored along with the key, NULL when the index is used as a set
+}Hash_slot;
+//one slot of an open addressing hash index
+
+typedef struct Hash_index_tag
+{
+    Hash_slot* slots    ;
+    size_t     capacity ;//number of slots, a power of two so the hash can be masked
+    size_t     count    ;//number of used slots
+}Hash_index;
+//hash index with linear probing that grows by doubling, it allocates nothing until the first insert
+
+typedef struct Top_k_entry_tag
+{
+    double score ;//transaction count or revenue the node is ranked by
+    void*  node  ;//Pair or Seller
+}Top_k_entry;
+
+typedef struct Top_k_tag
+{
+    Top_k_entry* heap  ;//min-heap, the smallest of the best k scores is at the root
+    size_t       k     ;//capacity of the heap
+    size_t       count ;
+    bool         stale ;//a score inside the heap went down, so a node outside may now belong in it
+}Top_k;
+//the k best scoring nodes seen so far
+
+typedef struct Slab_chunk_tag
+{
+    struct Slab_chunk_tag *next_chunk ;
+    size_t                 node_count ;
+    max_align_t            nodes[]    ;//the nodes of this chunk follow the header
+}Slab_chunk;
+//one contiguous block of memory that is carved into equally sized nodes
+
+typedef struct Free_slot_tag
+{
+    struct Free_slot_tag *next_free ;
+}Free_slot;
+//a freed node is reused to link it into the free list of its slab
+
+typedef struct Slab_tag
+{
+    size_t      node_size    ;//size of one node rounded up for alignment
+    size_t      chunk_nodes  ;//number of nodes in the next chunk to be allocated
+    Slab_chunk* chunk_list   ;
+    Free_slot*  free_list    ;//recycled nodes, handed out before fresh ones
+    char*       bump_pointer ;//next never used node of the newest chunk
+    size_t      nodes_left   ;//never used nodes left in the newest chunk
+}Slab;
+//arena that hands out nodes of a single type from large chunks
+
+typedef struct Record_columns_tag
+{
+    int*        transaction_id    ;
+    int*        seller_id         ;
+    int*        buyer_id          ;
+    float*      energy_amount     ;
+    float*      price_per_unit    ;
+    float*      transaction_money ;
+    uint32_t*   packed_time       ;
+    size_t      count             ;//rows in use
+    size_t      capacity          ;//rows allocated in every column
+}Record_columns;
+//struct-of-arrays copy of the record table, one dense array per field so that
+//a scan over one field only touches the memory of that field
+
+typedef struct Time_index_entry_tag
+{
+    uint32_t time_key ;//packed time of the record, a copy of its packed_time
+    Record*  record   ;
+}Time_index_entry;
+
+typedef struct Time_index_tag
+{
+    Time_index_entry* entries  ;//sorted by time_key, records with equal keys in insertion order
+    size_t            count    ;
+    size_t            capacity ;
+}Time_index;
+//secondary index that keeps every record ordered by the time of the transaction
+
+typedef struct Time_range_iterator_tag
+{
+    const Time_index_entry* next ;//next entry to hand out
+    const Time_index_entry* end  ;//one past the last entry inside the range
+}Time_range_iterator;
+//walks the records of one time range in time order
+
+typedef struct Energy_index_node_tag
+{
+    float   energy_amount ;//copy of the energy of the record, the key of the node
+    int     level         ;//number of levels the node is part of, the length of forward
+    Record* record        ;
+    struct Energy_index_node_tag *forward[];//next node on every level the node is part of
+}Energy_index_node;
+
+typedef struct Energy_index_tag
+{
+    Energy_index_node* head         ;//sentinel in front of the largest energy, allocated by the first insert
+    int                level        ;//number of levels in use
+    size_t             count        ;
+    uint32_t           random_state ;//drives the level of new nodes
+    Slab               node_slabs[ENERGY_INDEX_MAX_LEVEL];//nodes of level i + 1 come from node_slabs[i]
+}Energy_index;
+//skip list of every record ordered by energy, largest first and by transaction ID among equal energies
+
+typedef struct Energy_iterator_tag
+{
+    const Energy_index_node* next    ;//next node to hand out
+    float                    minimum ;//records must have more energy than this
+}Energy_iterator;
+//walks the records above an energy amount, largest first
+
+typedef struct Bulk_row_tag
+{
+    int        transaction_id ;
+    int        seller_id      ;
+    int        buyer_id       ;
+    float      energy_amount  ;
+    float      price_per_unit ;
+    time_stamp time           ;
+    size_t     line           ;//line of the file the row was read from
+}Bulk_row;
+//one parsed line of a load file
+
+typedef struct Bulk_load_summary_tag
+{
+    size_t lines               ;//lines read, blank and header lines included
+    size_t loaded              ;
+    size_t malformed           ;//lines that are not ten numbers
+    size_t invalid_time        ;
+    size_t invalid_id          ;//transaction, seller or buyer ID failing the Verhoeff-Gumm check
+    size_t invalid_amount      ;//energy or price that is not positive
+    size_t duplicate_id        ;//transaction ID already in the Database or earlier in the file
+    size_t failed              ;//valid rows that could not be stored
+    size_t first_rejected_line ;//0 when no line was rejected
+}Bulk_load_summary;
+//what a bulk load did with every line of its file
+
+typedef struct Database_benchmark_options_tag
+{
+    size_t      sellers   ;//distinct seller IDs the synthetic transactions draw from
+    size_t      buyers    ;//distinct buyer IDs
+    double      skew      ;//Zipf exponent of the seller and buyer draws, 0 draws uniformly
+    const char *json_path ;//NULL writes the results to stdout
+}Database_benchmark_options;
+//what --bench-db generates and where it writes its results
+
+typedef struct Benchmark_transaction_tag
+{
+    int        TID  ;
+    int        SID  ;
+    int        BID  ;
+    float      EA   ;
+    float      PPU  ;
+    time_stamp time ;
+}Benchmark_transaction;
+//one synthetic transaction of --bench-db, every ID has a valid check digit
+
+typedef struct Benchmark_generator_tag
+{
+    int          *transaction_ids ;//every valid ID in a random order, the transaction IDs of the first VALID_ID_COUNT rows
+    int          *seller_ids      ;//valid IDs in a random order, the first sellers of them are the sellers
+    int          *buyer_ids       ;
+    double       *seller_weights  ;//cumulative probability of drawing the sellers up to this one
+    double       *buyer_weights   ;
+    size_t        sellers         ;
+    size_t        buyers          ;
+    unsigned int  state           ;
+}Benchmark_generator;
+//where the synthetic transactions of --bench-db take their IDs from
+
+typedef struct Write_ahead_log_tag
+{
+    int             fd               ;//-1 when no log is open
+    char*           path             ;//file of the open log
+    size_t          sync_bytes       ;//group commit once this many bytes are waiting for fsync
+    long            sync_interval_ms ;//group commit once the oldest waiting entry is this old
+    size_t          unsynced_bytes   ;//bytes appended since the last fsync
+    struct timespec last_sync        ;
+    size_t          buffered         ;//bytes of buffer not yet written to the file
+    bool            broken           ;//a failed write could not be cut off the file again
+    uint8_t         buffer[WAL_BUFFER_SIZE];
+}Write_ahead_log;
+//append-only binary log of every insert and update, replayed on startup
+
+typedef struct Snapshot_row_tag
+{
+    int32_t  transaction_id ;
+    int32_t  seller_id      ;
+    int32_t  buyer_id       ;
+    float    energy_amount  ;
+    float    price_per_unit ;
+    uint32_t packed_time    ;
+}Snapshot_row;
+//one record in a snapshot file, the rows are stored in time order
+
+typedef struct Snapshot_slot_tag
+{
+    int32_t  transaction_id ;//0 marks an empty slot
+    uint32_t row            ;
+}Snapshot_slot;
+//one slot of the open addressing transaction ID index of a snapshot file
+
+typedef struct Snapshot_header_tag
+{
+    char     magic[8]     ;//SNAPSHOT_MAGIC
+    uint32_t version      ;//SNAPSHOT_VERSION
+    uint32_t row_size     ;//sizeof(Snapshot_row), guards against a different layout
+    uint64_t row_count    ;
+    uint64_t slot_count   ;//a power of two, at most half of the slots are used
+    uint64_t rows_offset  ;//file offsets of the two arrays
+    uint64_t slots_offset ;
+}Snapshot_header;
+//first bytes of a snapshot file
+
+typedef struct Snapshot_tag
+{
+    void*                map        ;//NULL when no snapshot is attached
+    size_t               map_size   ;
+    const Snapshot_row*  rows       ;
+    const Snapshot_slot* slots      ;
+    size_t               row_count  ;
+    size_t               slot_count ;
+    uint8_t*             materialized       ;//one bit per row, set once the row has become a record
+    size_t               materialized_count ;
+}Snapshot;
+//a snapshot file mapped into memory whose rows are not records of the Database yet
+
+typedef struct Background_save_tag
+{
+    pid_t pid        ;//child writing the snapshot, 0 when no save is running
+    off_t log_offset ;//end of the log when the child was forked, the snapshot holds everything before it
+}Background_save;
+//snapshot that a forked child is writing while the Database keeps working
 
 typedef struct Database_tag
 {
@@ -85,9 +345,26 @@ typedef struct Database_tag
     Buyer*  buyer_list              ;
     Pair*   pairs_list              ;
     key     sorted_based_on         ;
-    transaction_hash_node* hashTable[HASH_TABLE_SIZE]; // Hash table with chaining
+    Slab    record_slab             ;
+    Slab    seller_slab             ;
+    Slab    buyer_slab              ;//buyer list and the regular buyer lists of sellers
+    Slab    pair_slab               ;
+    Hash_index     tid_index        ;//every transaction ID in the Database along with its Record
+    Hash_index     seller_index     ;//seller ID to its node in seller_list
+    Hash_index     buyer_index      ;//buyer ID to its node in buyer_list
+    Hash_index     pair_index       ;//pair_key to its node in pairs_list
+    Time_index     time_index       ;//every record ordered by time
+    Energy_index   energy_index     ;//every record ordered by energy
+    Write_ahead_log log             ;//durable log of the inserts and updates, when one is open
+    Snapshot       snapshot         ;//mapped snapshot that still has to be turned into records
+    Background_save background_save ;
+    bool           live_rankings    ;//when set the rankings below follow every insert and update
+    Top_k          rankings[RANKING_COUNT];
+    uniqueness_mode unique_check    ;//which structure answers is_transaction_id_input_unique
+    uint64_t       tid_bitmap[TID_BITMAP_WORDS];//bit (ID - MIN_INPUT_NO) is set when the ID is in use
 }Database;
-//structure declaration that will hold the Record List, Seller list, Buyer list, pairs_list, Hashtable array.
+//structure declaration that will hold the Record List, Seller list, Buyer list, pairs_list, transaction ID index
+//and the slabs that every node of those lists is allocated from.
 
 //functions that implement transactions
 ////////////////////////////////////
@@ -95,14 +372,20 @@ void        initialise_database(Database*)
 void        time_fill(time_stamp*, int, int, int, int, int)                                               ;
 void        populate_seller_list(Database*)                                                               ;
 void        populate_buyer_list(Database*)                                                                ;
-void        filling_pairs(Database*)                                                                      ;
 void        populate_pairs_list(Database* db)                                                             ;
-void        fill_the_regular_buyers_list_in_seller_nodes(Database *db)                                    ;
-void        fill_the_price_per_unit_fields(Database *db)                                                  ;
 float       revenue_of_seller(Database*, int)                                                             ;
+Seller*     get_seller(Database*, int)                                                                    ;
+Buyer*      get_buyer(Database*, int)                                                                     ;
+Seller*     find_or_add_seller(Database*, int)                                                            ;
+Buyer*      find_or_add_buyer(Database*, int)                                                             ;
+Pair*       get_pair(Database*, int, int)                                                                 ;
+Pair*       find_or_add_pair(Database*, int, int)                                                         ;
+void        apply_record_to_aggregates(Database*, Record*, int, float, float)                             ;
 Pair*       find_pair_that_has_maximum_transactions(Database*)                                            ;
 status_code update_existing_transaction(Database* db, int TID, float EA, float PPU, time_stamp samay)     ;
+Record*     get_transaction(Database*, int)                                                               ;
 status_code insert_record_into_record_list(Database*, int, int ,int , float, float, time_stamp*, Record**);
+status_code add_validated_record(Database*, int, int, int, float, float, uint32_t, bool, Record**)        ;
 
 /////////////////////////
 //functions that I used in the sorting implementation 
@@ -111,6 +394,10 @@ Record* merge_sorted_lists(Record*, Record*, key)                 ;
 Record* division(Record*)                                         ;
 Record* sort_records(Record*, key)                                ;
 Record* sort_records_wrapper(Database*, key)                      ;
+uint64_t record_sort_key(const Record*, key)                      ;
+Record* radix_sort_records(Record*, key)                          ;
+Record* natural_merge_sort_records(Record*, key)                  ;
+size_t  count_natural_runs(Record*, key, size_t)                  ;
 Buyer*  divide_buyer_list(Buyer*)                                 ;
 Buyer*  merge_buyer_lists(Buyer*, Buyer*)                         ;
 Buyer*  merge_sort_buyer_list(Buyer*)                             ;
@@ -126,19 +413,125 @@ void    sort_pairs_list_based_on_number_of_transactions(Database*);
 
 
 
+///////////////////////////
+//functions that implement the top-K rankings
+
+status_code initialise_top_k(Top_k*, size_t)                        ;
+void        top_k_offer(Top_k*, double, void*)                      ;
+void        top_k_track(Top_k*, double, void*)                      ;
+void        free_top_k(Top_k*)                                      ;
+double      ranking_score(ranking, const void*)                     ;
+size_t      top_k(Database*, ranking, size_t, void**)               ;
+status_code enable_live_rankings(Database*, size_t)                 ;
+void        display_top_k(Database*, ranking, size_t)               ;
+
+///////////////////////////
+//functions that implement the slab allocator
+
+void  initialise_slab(Slab*, size_t)   ;
+void* slab_alloc(Slab*)                ;
+void  slab_free(Slab*, void*)          ;
+void  slab_release(Slab*)              ;
+
+///////////////////////////
+//functions that implement the columnar record store
+
+void        initialise_record_columns(Record_columns*)                                     ;
+status_code append_record_to_columns(Record_columns*, const Record*)                      ;
+void        free_record_columns(Record_columns*)                                          ;
+float       column_masked_sum(const int*, const float*, size_t, int, size_t*)             ;
+size_t      column_index_of_maximum(const float*, size_t)                                 ;
+int         run_columnar_benchmark(size_t)                                                ;
+int         run_sort_benchmark(size_t)                                                    ;
+int         run_database_benchmark(const size_t*, size_t, const Database_benchmark_options*);
+
 ///////////////////////////
 //functions in to implement hash_table 
 
 void          initialise_the_hashtable(Database *db)                         ;
-status_code   storing_the_transactionID_along_with_hash(Database *db, int id);
-unsigned long hashing_function(int id)                                       ;
+status_code   storing_the_transactionID_along_with_hash(Database *db, int id, Record* record);
+unsigned long hash_key(uint64_t)                                                             ;
+uint64_t      pair_key(int, int)                                                             ;
+void          initialise_hash_index(Hash_index*)                                             ;
+Hash_slot*    hash_index_find(const Hash_index*, uint64_t)                                   ;
+status_code   hash_index_insert(Hash_index*, uint64_t, void*)                                ;
+void          hash_index_remove(Hash_index*, uint64_t)                                       ;
+void          free_hash_index(Hash_index*)                                                   ;
+
+///////////////////////////
+//functions that implement the time index
+
+uint32_t            pack_time_stamp(time_stamp)                                     ;
+time_stamp          unpack_time_stamp(uint32_t)                                     ;
+void                initialise_time_index(Time_index*)                              ;
+size_t              time_index_lower_bound(const Time_index*, uint32_t)             ;
+status_code         time_index_insert(Time_index*, uint32_t, Record*)               ;
+status_code         time_index_append(Time_index*, uint32_t, Record*)               ;
+status_code         time_index_sort_from(Time_index*, size_t)                       ;
+void                time_index_remove(Time_index*, uint32_t, Record*)               ;
+void                free_time_index(Time_index*)                                    ;
+Time_range_iterator records_between_time(Database*, time_stamp, time_stamp)         ;
+Record*             next_record_in_time_range(Time_range_iterator*)                 ;
+size_t              count_records_between_time(Database*, time_stamp, time_stamp)   ;
+
+///////////////////////////
+//functions that implement the energy index
+
+void            initialise_energy_index(Energy_index*)                        ;
+status_code     energy_index_insert(Energy_index*, Record*)                   ;
+void            energy_index_remove(Energy_index*, float, Record*)            ;
+void            free_energy_index(Energy_index*)                              ;
+const Energy_index_node* energy_index_first(const Energy_index*)              ;
+Record*         record_with_maximum_energy(Database*)                         ;
+size_t          records_with_most_energy(Database*, size_t, Record**)         ;
+Energy_iterator records_above_energy(Database*, float)                        ;
+Record*         next_record_above_energy(Energy_iterator*)                    ;
+
+///////////////////////////
+//functions that implement the bulk loader
+
+status_code bulk_load_transactions(Database*, const char*, Bulk_load_summary*)  ;
+bool        parse_bulk_row(const char*, const char*, Bulk_row*)                 ;
+void        display_bulk_load_summary(const char*, const Bulk_load_summary*)    ;
+
+///////////////////////////
+//functions that implement the write-ahead log
+
+void        initialise_write_ahead_log(Write_ahead_log*)                        ;
+status_code open_write_ahead_log(Database*, const char*, size_t, long)           ;
+status_code log_inserted_record(Write_ahead_log*, const Record*)                ;
+status_code log_updated_record(Write_ahead_log*, const Record*)                 ;
+status_code sync_write_ahead_log(Write_ahead_log*)                              ;
+void        close_write_ahead_log(Write_ahead_log*)                             ;
+
+///////////////////////////
+//functions that implement the snapshot files
+
+status_code save_snapshot(Database*, const char*)                               ;
+status_code open_snapshot(Database*, const char*)                               ;
+bool        snapshot_contains(const Snapshot*, int)                             ;
+status_code materialize_snapshot(Database*)                                     ;
+status_code materialize_snapshot_row(Database*, int)                            ;
+void        close_snapshot(Snapshot*)                                           ;
+status_code truncate_write_ahead_log(Write_ahead_log*)                          ;
+status_code drop_write_ahead_log_before(Write_ahead_log*, off_t)                ;
+status_code save_snapshot_in_background(Database*, const char*)                 ;
+void        finish_background_save(Database*, bool)                             ;
+
+///////////////////////////
+//functions that implement the transaction ID bitmap
+
+bool   transaction_id_bitmap_test(const Database*, int)                      ;
+bool   transaction_id_bitmap_test_and_set(Database*, int)                    ;
+void   transaction_id_bitmap_clear(Database*, int)                           ;
+size_t count_used_transaction_ids(const Database*)                           ;
+int    next_free_transaction_id(const Database*, int)                        ;
+int    next_free_valid_transaction_id(const Database*, int)                  ;
 
 //////////////////////////
 //functions in to validate inputs 
 // Calculate check digit for a 5-digit number
-static int f(int,int);
 int  calculate_check_digit(int number)                                   ;
-int  compare_time_stamps(time_stamp, time_stamp)                         ;
 int  compare_records(Record*, Record*, key)                              ;
 bool validate_complete_number(int number)                                ;
 bool is_time_input_valid(time_stamp)                                     ;
@@ -154,61 +547,19 @@ bool validity_checker(Database*,int, int, int, float, float, time_stamp*);
 void display_records(Database*)                                     ;
 void display_records_between_time(Database*, time_stamp, time_stamp);
 void display_transaction_with_maximum_energy_amount(Database*)      ;
+void display_records_with_most_energy(Database*, size_t)            ;
+void display_records_above_energy(Database*, float)                 ;
 void display_sellers_list(Database*)                                ;
 void display_buyers_list(Database*)                                 ;
 void display_sorted_pairs(Database*)                                ;
 void clear(Database*)                                               ;
 //////////////////////////////////////////////////////////////////
 
-// Dihedral permutation table
-static const int permuatation_table[8][10] = {
-    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
-    {1, 5, 7, 6, 2, 8, 3, 0, 9, 4},
-    {5, 8, 0, 3, 7, 9, 6, 1, 4, 2},
-    {8, 9, 1, 6, 0, 4, 3, 5, 2, 7},
-    {9, 4, 5, 3, 1, 2, 6, 8, 7, 0},
-    {4, 2, 8, 6, 5, 7, 3, 9, 0, 1},
-    {2, 7, 9, 3, 8, 0, 6, 4, 1, 5},
-    {7, 0, 4, 6, 9, 1, 3, 2, 5, 8}
-};
-
-// Non-commutative multiplication table (D5 group)
-static const int d5_mult_table[10][10] = {
-    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
-    {1, 2, 3, 4, 0, 6, 7, 8, 9, 5},
-    {2, 3, 4, 0, 1, 7, 8, 9, 5, 6},
-    {3, 4, 0, 1, 2, 8, 9, 5, 6, 7},
-    {4, 0, 1, 2, 3, 9, 5, 6, 7, 8},
-    {5, 9, 8, 7, 6, 0, 4, 3, 2, 1},
-    {6, 5, 9, 8, 7, 1, 0, 4, 3, 2},
-    {7, 6, 5, 9, 8, 2, 1, 0, 4, 3},
-    {8, 7, 6, 5, 9, 3, 2, 1, 0, 4},
-    {9, 8, 7, 6, 5, 4, 3, 2, 1, 0}
-};
-
-// Inverse lookup table
-static const int inv_table[10] = {0, 4, 3, 2, 1, 5, 9, 8, 7, 6};
-
-// Implementation of f(a,b) as described
-static int f(int a, int b) {
-    return d5_mult_table[a][permuatation_table[0][b]];
-}
-
+// The D5 tables and the two-level digit tables live in verhoeff_batch.h, the
+// utility and the benchmarks use the same ones
 int calculate_check_digit(int number) {
     if (number < 10000 || number > 99999) return -1;
-    
-    // individual digits
-    int a1 = (number / 10000) % 10;
-    int a2 = (number / 1000) % 10 ;
-    int a3 = (number / 100) % 10  ;
-    int a4 = (number / 10) % 10   ;
-    int a5 = number % 10          ;
-    
-    // Calculate c = f(a1,f(a2,f(a3,f(a4,a5))))
-    int c = f(a1, f(a2, f(a3, f(a4, a5))));
-    
-    // Return inverse of c in the group
-    return inv_table[c];
+    return verhoeff_check_digit(number); // two table lookups instead of five chained ones
 }
 
 bool validate_complete_number(int number) {
@@ -273,19 +624,13 @@ bool is_time_input_valid(time_stamp time)
 // Unique transaction ID function implementation using a hashmap approach
 // Maintaining a hashmap so that the lookup is only constant time
 bool is_transaction_id_input_unique(Database *db, int id) {
-    unsigned long index = hashing_function(id); // Get the hash of the ID
-    transaction_hash_node* curr = db->hashTable[index]; // Access hash table through database
-    bool valid = true; // Initialize flag to SUCCESS
-    
-    while (curr) { // Loop through the linked list
-        if (curr->id == id) { // Compare integer ID
-            valid = false; // Set flag to FAILURE if found
-            break; // Exit the loop since we found the ID
-        }
-        curr = curr->next; // Move to the next node
+    if (snapshot_contains(&db->snapshot, id)) {
+        return false; // a row of the snapshot that is not a record yet
     }
-    
-    return valid; // Return the flag (either valid or not)
+    if (db->unique_check == BITMAP_LOOKUP) {
+        return !transaction_id_bitmap_test(db, id); // one bit, one cache line
+    }
+    return hash_index_find(&db->tid_index, (unsigned long)id) == NULL; // one probe sequence in the index
 }
 
 // for each of these validity checkers this program implements a 
@@ -345,6 +690,10 @@ bool validity_checker(Database *db, int TID, int SID, int BID, float EA, float P
     // Check transaction ID uniqueness
     if (!is_transaction_id_input_unique(db, TID)) { // Pass Database pointer
         printf("ERROR: Transaction ID %d is not unique. It already exists in the system.\n", TID);
+        int free_id = next_free_valid_transaction_id(db, TID);
+        if (free_id != -1) {
+            printf("The next free valid Transaction ID is %d.\n", free_id);
+        }
         valid = false;
     }
 
@@ -380,72 +729,20 @@ bool validity_checker(Database *db, int TID, int SID, int BID, float EA, float P
     return valid;
 }
 
-int compare_time_stamps(time_stamp t1, time_stamp t2)
-{
-    int result;
-
-    if (t1.year < t2.year)
-    {
-        result = -1;
-    }
-    else if (t1.year > t2.year)
-    {
-        result = 1;
-    }
-    else if (t1.month < t2.month)
-    {
-        result = -1;
-    }
-    else if (t1.month > t2.month)
-    {
-        result = 1;
-    }
-    else if (t1.date < t2.date)
-    {
-        result = -1;
-    }
-    else if (t1.date > t2.date)
-    {
-        result = 1;
-    }
-    else if (t1.hours < t2.hours)
-    {
-        result = -1;
-    }
-    else if (t1.hours > t2.hours)
-    {
-        result = 1;
-    }
-    else if (t1.minutes < t2.minutes)
-    {
-        result = -1;
-    }
-    else if (t1.minutes > t2.minutes)
-    {
-        result = 1;
-    }
-    else
-    {
-        result = 0;
-    }
-
-    return result;
-}
-
 int compare_records(Record *a, Record *b, key sorting_key) {
     switch (sorting_key) {
         case MONTHS:
-            return a->time.month - b->time.month;
+            return (int)((a->packed_time >> 16) & 15) - (int)((b->packed_time >> 16) & 15);
         case SELLER_ID:
             return a->seller_id - b->seller_id;
         case BUYER_ID:
             return a->buyer_id - b->buyer_id;
         case UNIQUE_PAIR_ID:
-            return (a->seller_id * 10000 + a->buyer_id) - (b->seller_id * 10000 + b->buyer_id);
+            return (a->unique_pair_id > b->unique_pair_id) - (a->unique_pair_id < b->unique_pair_id);
         case ENERGY:
             return (a->energy_amount > b->energy_amount) - (a->energy_amount < b->energy_amount);
         case TIME:
-            return compare_time_stamps(a->time,b->time) ;
+            return (a->packed_time > b->packed_time) - (a->packed_time < b->packed_time);
         default:
             return 0;
     }
@@ -453,8 +750,51 @@ int compare_records(Record *a, Record *b, key sorting_key) {
 /////////////////////////////////
 
 
+static void display_listed_record(const Record *current)
+{
+    time_stamp time = unpack_time_stamp(current->packed_time);
+    printf("TRANSACTION DETAILS\n TID: %d \n SID: %d \n BID: %d \n Energy Amount: %.2f \n Price: %.2f \n Date: %02d-%02d-%04d\n Time: %02d:%02d\n\n", 
+           current->transaction_id , 
+           current->seller_id      , 
+           current->buyer_id       , 
+           current->energy_amount  , 
+           current->price_per_unit ,
+           time.date               ,
+           time.month              ,
+           time.year               ,
+           time.hours              ,
+           time.minutes)           ;
+}
+
+// A row of the attached snapshot in the shape of a record, for displaying it
+static Record snapshot_row_as_record(const Snapshot_row *row)
+{
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.transaction_id = row->transaction_id;
+    record.seller_id      = row->seller_id;
+    record.buyer_id       = row->buyer_id;
+    record.energy_amount  = row->energy_amount;
+    record.price_per_unit = row->price_per_unit;
+    record.packed_time    = row->packed_time;
+    return record;
+}
+
+static bool is_snapshot_row_materialized(const Snapshot *snapshot, size_t row)
+{
+    return (snapshot->materialized[row >> 3] >> (row & 7)) & 1;
+}
+
+// True when there are neither records nor snapshot rows that are not records yet
+static bool is_database_empty(const Database *db)
+{
+    return !db->record_list && db->snapshot.materialized_count == db->snapshot.row_count;
+}
+
+// The records, then the snapshot rows that are not records yet, latest first.
+// The rows are displayed straight from the mapped file.
 void display_records(Database *db) {
-    if (!db || !db->record_list) {
+    if (!db || is_database_empty(db)) {
         printf("No records to display.\n");
         return;
     }
@@ -462,29 +802,42 @@ void display_records(Database *db) {
     Record *current = db->record_list;
     printf("\nDisplaying all Transactions:\n");
     while (current) {
-        printf("TRANSACTION DETAILS\n TID: %d \n SID: %d \n BID: %d \n Energy Amount: %.2f \n Price: %.2f \n Date: %02d-%02d-%04d\n Time: %02d:%02d\n\n", 
-               current->transaction_id , 
-               current->seller_id      , 
-               current->buyer_id       , 
-               current->energy_amount  , 
-               current->price_per_unit ,
-               current->time.date      ,
-               current->time.month     ,
-               current->time.year      ,
-               current->time.hours     ,
-               current->time.minutes)  ;
+        display_listed_record(current);
         current = current->next_record ;
     }
+    const Snapshot *snapshot = &db->snapshot;
+    for (size_t row = snapshot->row_count; row-- > 0; ) {
+        if (is_snapshot_row_materialized(snapshot, row)) continue;
+        Record record = snapshot_row_as_record(&snapshot->rows[row]);
+        display_listed_record(&record);
+    }
+}
+
+// First row of the attached snapshot whose time is not before time_key. The rows
+// are in time order, so this is a binary search over the mapped file.
+static size_t snapshot_lower_bound(const Snapshot *snapshot, uint32_t time_key)
+{
+    size_t low = 0, high = snapshot->row_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (snapshot->rows[middle].packed_time < time_key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
 }
 
+// The records of the time index and the rows of the snapshot that are not records
+// yet are both in time order, and are merged while they are displayed
 void display_records_between_time(Database *db, time_stamp t1, time_stamp t2) {
-    if (!db || !db->record_list) {
+    if (!db || is_database_empty(db)) {
         printf("No records to display.\n");
         return;
     }
     bool valid_inputs = is_time_input_valid(t1)&& is_time_input_valid(t2);
-    int  smaller      = compare_time_stamps(t1, t2)                      ;
-    if (smaller == 1) {
+    if (valid_inputs && pack_time_stamp(t1) > pack_time_stamp(t2)) {
         time_stamp temp = t1;
         t1 = t2;
         t2 = temp;
@@ -497,61 +850,223 @@ void display_records_between_time(Database *db, time_stamp t1, time_stamp t2) {
     printf("All transactions between %02d/%02d/%04d and %02d/%02d/%04d are:\n", 
            t1.date, t1.month, t1.year, t2.date, t2.month, t2.year);
     
-    Record *current = db->record_list;
-    while (current) {
-        int a = compare_time_stamps(t1, current->time);
-        int b = compare_time_stamps(t2, current->time);
-        if ((a != 1) && (b != -1)) {
-            printf("TRANSACTION DETAILS\n TID: %d \n SID: %d \n BID: %d \n Energy Amount: %.2f \n Price: %.2f \n Date: %02d-%02d-%04d\n Time: %02d:%02d\n\n", 
-                   current->transaction_id, 
-                   current->seller_id     , 
-                   current->buyer_id      , 
-                   current->energy_amount , 
-                   current->price_per_unit,
-                   current->time.date     ,
-                   current->time.month    ,
-                   current->time.year     ,
-                   current->time.hours    ,
-                   current->time.minutes);
+    // the time index and the snapshot rows both seek straight to the first entry of the range
+    const Snapshot *snapshot = &db->snapshot;
+    size_t row     = snapshot->map ? snapshot_lower_bound(snapshot, pack_time_stamp(t1)) : 0;
+    size_t row_end = snapshot->map ? snapshot_lower_bound(snapshot, pack_time_stamp(t2) + 1) : 0;
+    Time_range_iterator range = records_between_time(db, t1, t2);
+    Record *current = next_record_in_time_range(&range);
+    for (;;) {
+        while (row < row_end && is_snapshot_row_materialized(snapshot, row)) row++;
+        if (row < row_end && (!current || snapshot->rows[row].packed_time < current->packed_time)) {
+            Record record = snapshot_row_as_record(&snapshot->rows[row++]);
+            display_listed_record(&record);
+        } else if (current) {
+            display_listed_record(current);
+            current = next_record_in_time_range(&range);
+        } else {
+            break;
+        }
+    }
+}
+
+static void display_transaction_details(const Record *record)
+{
+    time_stamp time = unpack_time_stamp(record->packed_time);
+    printf(" TRANSACTION DETAILS \n TID: %d \n SID: %d \n BID: %d \n Energy Amount: %.2f \n Price: %.2f \n Date: %02d-%02d-%04d\n Time: %02d:%02d\n\n",
+           record->transaction_id ,
+           record->seller_id      ,
+           record->buyer_id       ,
+           record->energy_amount  ,
+           record->price_per_unit ,
+           time.date              ,
+           time.month             ,
+           time.year              ,
+           time.hours             ,
+           time.minutes);
+}
+
+// True when snapshot row a comes before row b in the order of the energy index:
+// more energy first, and the smaller transaction ID first among equal energies
+static bool snapshot_row_precedes(const Snapshot_row *a, const Snapshot_row *b)
+{
+    return a->energy_amount > b->energy_amount ||
+           (a->energy_amount == b->energy_amount && a->transaction_id < b->transaction_id);
+}
+
+// The same order between a snapshot row and a record of the energy index
+static bool snapshot_row_precedes_record(const Snapshot_row *row, const Record *record)
+{
+    return row->energy_amount > record->energy_amount ||
+           (row->energy_amount == record->energy_amount && row->transaction_id < record->transaction_id);
+}
+
+static int compare_snapshot_rows_by_energy(const void *a, const void *b)
+{
+    const Snapshot_row *first  = *(const Snapshot_row* const*)a;
+    const Snapshot_row *second = *(const Snapshot_row* const*)b;
+    return snapshot_row_precedes(first, second) ? -1 : snapshot_row_precedes(second, first) ? 1 : 0;
+}
+
+// Move heap[at] down until neither child comes after it in energy order, so the
+// row that comes last stays at the top of the heap
+static void sift_down_last_snapshot_row(const Snapshot_row **heap, size_t count, size_t at)
+{
+    for (;;) {
+        size_t last = at, left = 2 * at + 1, right = left + 1;
+        if (left < count && snapshot_row_precedes(heap[last], heap[left])) last = left;
+        if (right < count && snapshot_row_precedes(heap[last], heap[right])) last = right;
+        if (last == at) return;
+        const Snapshot_row *temp = heap[at];
+        heap[at]   = heap[last];
+        heap[last] = temp;
+        at = last;
+    }
+}
+
+// The rows of the snapshot that are not records yet and have more energy than the
+// minimum, at most limit of them, in the order of the energy index. The mapped rows
+// are scanned without turning them into records: once limit rows are found, a heap
+// keeps the limit best ones seen so far. *rows is allocated here and freed by the
+// caller.
+static status_code snapshot_rows_by_energy(const Snapshot *snapshot, float minimum, size_t limit,
+                                           const Snapshot_row ***rows, size_t *count)
+{
+    *rows  = NULL;
+    *count = 0;
+    size_t matches = 0;
+    for (size_t row = 0; row < snapshot->row_count; row++) {
+        matches += !is_snapshot_row_materialized(snapshot, row) && snapshot->rows[row].energy_amount > minimum;
+    }
+    size_t capacity = matches < limit ? matches : limit;
+    if (capacity == 0) return SUCCESS;
+    const Snapshot_row **heap = (const Snapshot_row**)malloc(capacity * sizeof(const Snapshot_row*));
+    if (!heap) {
+        printf("Memory allocation failed!\n");
+        return FAILURE;
+    }
+
+    size_t used = 0;
+    for (size_t row = 0; row < snapshot->row_count; row++) {
+        const Snapshot_row *candidate = &snapshot->rows[row];
+        if (is_snapshot_row_materialized(snapshot, row) || !(candidate->energy_amount > minimum)) continue;
+        if (used < capacity) {
+            heap[used++] = candidate;
+            if (used == capacity) {
+                for (size_t at = capacity / 2; at-- > 0; ) {
+                    sift_down_last_snapshot_row(heap, capacity, at);
+                }
+            }
+        } else if (snapshot_row_precedes(candidate, heap[0])) {
+            heap[0] = candidate;
+            sift_down_last_snapshot_row(heap, capacity, 0);
         }
-        current = current->next_record;
     }
+    qsort(heap, capacity, sizeof(const Snapshot_row*), compare_snapshot_rows_by_energy);
+    *rows  = heap;
+    *count = capacity;
+    return SUCCESS;
 }
 
+// The energy queries merge the energy index with the snapshot rows that are not
+// records yet, which are read from the mapped file and not turned into records
 void display_transaction_with_maximum_energy_amount(Database *db)
 {
-    if (db->record_list == NULL)
+    // the energy index keeps the largest energy at its head
+    Record *max_energy_record = record_with_maximum_energy(db);
+    const Snapshot_row **rows;
+    size_t row_count;
+    if (snapshot_rows_by_energy(&db->snapshot, -INFINITY, 1, &rows, &row_count) == FAILURE) return;
+    if (max_energy_record == NULL && row_count == 0)
     {
         printf("No transactions available.\n");
         return;
     }
 
-    Record *max_energy_record = db->record_list;
-    Record *current_record = db->record_list   ;
+    printf("\n\n The transaction with maximum energy amount is : \n");
+    if (row_count > 0 && (!max_energy_record || snapshot_row_precedes_record(rows[0], max_energy_record)))
+    {
+        Record record = snapshot_row_as_record(rows[0]);
+        display_transaction_details(&record);
+    }
+    else
+    {
+        display_transaction_details(max_energy_record);
+    }
+    free(rows);
+}
 
-    while (current_record != NULL)
+void display_records_with_most_energy(Database *db, size_t n)
+{
+    Record **records = (Record**)malloc((n ? n : 1) * sizeof(Record*));
+    const Snapshot_row **rows = NULL;
+    size_t row_count = 0;
+    if (!records)
+    {
+        printf("Memory allocation failed!\n");
+        return;
+    }
+    if (snapshot_rows_by_energy(&db->snapshot, -INFINITY, n, &rows, &row_count) == FAILURE)
+    {
+        free(records);
+        return;
+    }
+    size_t record_count = records_with_most_energy(db, n, records);
+    size_t found = record_count + row_count < n ? record_count + row_count : n;
+    if (found == 0)
+    {
+        printf("No transactions available.\n");
+    }
+    else
+    {
+        printf("\n\n The %zu transactions with the most energy are : \n", found);
+    }
+    size_t record = 0, row = 0;
+    for (size_t i = 0; i < found; i++)
     {
-        if (current_record->energy_amount > max_energy_record->energy_amount)
+        if (row < row_count && (record == record_count || snapshot_row_precedes_record(rows[row], records[record])))
+        {
+            Record row_record = snapshot_row_as_record(rows[row++]);
+            display_transaction_details(&row_record);
+        }
+        else
         {
-            max_energy_record = current_record;
+            display_transaction_details(records[record++]);
         }
-        current_record = current_record->next_record;
     }
-
-    printf("\n\n The transaction with maximum energy amount is : \n");
-    printf(" TRANSACTION DETAILS \n TID: %d \n SID: %d \n BID: %d \n Energy Amount: %.2f \n Price: %.2f \n Date: %02d-%02d-%04d\n Time: %02d:%02d\n\n",
-           max_energy_record->transaction_id ,
-           max_energy_record->seller_id      ,
-           max_energy_record->buyer_id       ,
-           max_energy_record->energy_amount  ,
-           max_energy_record->price_per_unit ,
-           max_energy_record->time.date      ,
-           max_energy_record->time.month     ,
-           max_energy_record->time.year      ,
-           max_energy_record->time.hours     ,
-           max_energy_record->time.minutes);
+    free(rows);
+    free(records);
 }
 
+void display_records_above_energy(Database *db, float minimum)
+{
+    const Snapshot_row **rows;
+    size_t row_count;
+    if (snapshot_rows_by_energy(&db->snapshot, minimum, SIZE_MAX, &rows, &row_count) == FAILURE) return;
+    printf("All transactions with more than %.2f kWh are:\n", minimum);
+    Energy_iterator above = records_above_energy(db, minimum);
+    Record *current = next_record_above_energy(&above);
+    size_t row = 0, found = 0;
+    while (current || row < row_count)
+    {
+        found++;
+        if (row < row_count && (!current || snapshot_row_precedes_record(rows[row], current)))
+        {
+            Record record = snapshot_row_as_record(rows[row++]);
+            display_transaction_details(&record);
+        }
+        else
+        {
+            display_transaction_details(current);
+            current = next_record_above_energy(&above);
+        }
+    }
+    if (found == 0)
+    {
+        printf("No transactions available.\n");
+    }
+    free(rows);
+}
 
 // Function to display all sellers along with their regular buyers
 void display_sellers_list(Database* db) {
@@ -628,94 +1143,1631 @@ void display_sorted_pairs(Database* db) {
 }
 
 
-// Initialize the hash table within the Database structure
-void initialise_the_hashtable(Database *db) {
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        db->hashTable[i] = NULL; // Set all entries in the table to NULL initially
+// Slab allocator: every node type of the Database lives in its own slab so that
+// nodes are packed next to each other in large chunks instead of being scattered
+// by one malloc per node, and the whole slab is given back with one free per chunk.
+void initialise_slab(Slab *slab, size_t node_size) {
+    size_t alignment = sizeof(void*); // nodes only hold ints, floats and pointers
+    if (node_size < sizeof(Free_slot)) {
+        node_size = sizeof(Free_slot); // a free node must be able to hold the free list link
     }
+    slab->node_size    = (node_size + alignment - 1) / alignment * alignment;
+    slab->chunk_nodes  = SLAB_FIRST_CHUNK_NODES;
+    slab->chunk_list   = NULL;
+    slab->free_list    = NULL;
+    slab->bump_pointer = NULL;
+    slab->nodes_left   = 0;
 }
 
-// Hash function to compute an index based on transaction ID
-unsigned long hashing_function(int id) {
-    unsigned long hash = 0;
-    for (int i = 0; i < 5; i++) {
-        hash = (hash * 31 + (id % 10)) % HASH_TABLE_SIZE; // Extract each digit and compute hash
-        id /= 10; // Move to the next digit
+// Hand out one node, reusing a freed node before carving a new one out of a chunk
+void* slab_alloc(Slab *slab) {
+    void *node = NULL;
+    if (slab->free_list) {
+        node = slab->free_list;
+        slab->free_list = slab->free_list->next_free;
+    } else {
+        if (slab->nodes_left == 0) {
+            Slab_chunk *chunk = (Slab_chunk*)malloc(sizeof(Slab_chunk) + slab->chunk_nodes * slab->node_size);
+            if (!chunk) {
+                printf("Memory allocation failed!\n");
+                return NULL;
+            }
+            chunk->node_count  = slab->chunk_nodes;
+            chunk->next_chunk  = slab->chunk_list;
+            slab->chunk_list   = chunk;
+            slab->bump_pointer = (char*)chunk->nodes;
+            slab->nodes_left   = chunk->node_count;
+            if (slab->chunk_nodes < SLAB_MAX_CHUNK_NODES) {
+                slab->chunk_nodes *= 2; // grow geometrically so big databases need only a few chunks
+            }
+        }
+        node = slab->bump_pointer;
+        slab->bump_pointer += slab->node_size;
+        slab->nodes_left--;
     }
-    return hash;
+    return node;
 }
 
-// Store the transaction ID along with its hash value in the hash table
-status_code storing_the_transactionID_along_with_hash(Database *db, int id) {
-    status_code SC = SUCCESS;
-    unsigned long index = hashing_function(id); // Get the hash of the ID
-    unsigned long hashValue = hashing_function(id); // Store the hash value
+// Give a node back to its slab, it will be handed out again by the next slab_alloc
+void slab_free(Slab *slab, void *node) {
+    if (!node) return;
+    Free_slot *slot = (Free_slot*)node;
+    slot->next_free = slab->free_list;
+    slab->free_list = slot;
+}
 
-    transaction_hash_node* newTransaction = (transaction_hash_node*)malloc(sizeof(transaction_hash_node));
-    if (!newTransaction) {
-        printf("Memory allocation failed!\n");
-        SC = FAILURE; // Allocation failed
-    } else {
-        newTransaction->id = id;                     // Store the integer ID
-        newTransaction->hashValue = hashValue;       // Store the hash value
-        newTransaction->next = db->hashTable[index]; // Link to the existing list
-        db->hashTable[index] = newTransaction;       // Update hash table with new transaction
+// Free every chunk of the slab at once, all nodes handed out by it become invalid
+void slab_release(Slab *slab) {
+    Slab_chunk *chunk = slab->chunk_list;
+    while (chunk) {
+        Slab_chunk *temp = chunk;
+        chunk = chunk->next_chunk;
+        free(temp);
     }
-    return SC; // Success
+    initialise_slab(slab, slab->node_size);
 }
 
-// I have stored these as a part of meta data that will 
-// ensure the checking of the transaction ID , Seller ID, Buyer ID 
-
-///////////////////////////////
-Record *merge_sorted_lists(Record *left, Record *right, key sorting_key) {
-    if (!left) return right;
-    if (!right) return left;
+///////////////////////////
+// Columnar record store: a copy of the records kept as one dense array per field.
+// Only --bench-columnar builds one, from records that are never updated, so rows
+// are only ever appended.
+
+void initialise_record_columns(Record_columns *columns) {
+    columns->transaction_id    = NULL;
+    columns->seller_id         = NULL;
+    columns->buyer_id          = NULL;
+    columns->energy_amount     = NULL;
+    columns->price_per_unit    = NULL;
+    columns->transaction_money = NULL;
+    columns->packed_time       = NULL;
+    columns->count             = 0;
+    columns->capacity          = 0;
+}
 
-    Record *head = NULL, *tail = NULL;
-    if (compare_records(left, right, sorting_key) <= 0) {
-        head = left;
-        left = left->next_record;
-    } else {
-        head = right;
-        right = right->next_record;
+// Grow every column to the new capacity, the columns are left untouched on failure
+static status_code grow_record_columns(Record_columns *columns, size_t capacity) {
+    int        *transaction_id    = (int*)realloc(columns->transaction_id, capacity * sizeof(int));
+    if (transaction_id) columns->transaction_id = transaction_id;
+    int        *seller_id         = (int*)realloc(columns->seller_id, capacity * sizeof(int));
+    if (seller_id) columns->seller_id = seller_id;
+    int        *buyer_id          = (int*)realloc(columns->buyer_id, capacity * sizeof(int));
+    if (buyer_id) columns->buyer_id = buyer_id;
+    float      *energy_amount     = (float*)realloc(columns->energy_amount, capacity * sizeof(float));
+    if (energy_amount) columns->energy_amount = energy_amount;
+    float      *price_per_unit    = (float*)realloc(columns->price_per_unit, capacity * sizeof(float));
+    if (price_per_unit) columns->price_per_unit = price_per_unit;
+    float      *transaction_money = (float*)realloc(columns->transaction_money, capacity * sizeof(float));
+    if (transaction_money) columns->transaction_money = transaction_money;
+    uint32_t   *packed_time       = (uint32_t*)realloc(columns->packed_time, capacity * sizeof(uint32_t));
+    if (packed_time) columns->packed_time = packed_time;
+
+    if (!transaction_id || !seller_id || !buyer_id || !energy_amount ||
+        !price_per_unit || !transaction_money || !packed_time) {
+        printf("Memory allocation failed!\n");
+        return FAILURE; // the columns that did grow keep their old rows and stay valid
     }
-    tail = head;
+    columns->capacity = capacity;
+    return SUCCESS;
+}
 
-    while (left && right) {
-        if (compare_records(left, right, sorting_key) <= 0) {
-            tail->next_record = left;
-            left = left->next_record;
-        } else {
-            tail->next_record = right;
-            right = right->next_record;
+// Copy the fields of a record into a new row of the columns
+status_code append_record_to_columns(Record_columns *columns, const Record *record) {
+    if (columns->count == columns->capacity) {
+        size_t capacity = columns->capacity ? columns->capacity * 2 : COLUMN_INITIAL_CAPACITY;
+        if (grow_record_columns(columns, capacity) == FAILURE) {
+            return FAILURE;
         }
-        tail = tail->next_record;
     }
-    tail->next_record = (left) ? left : right;
-    return head;
+    size_t row = columns->count++;
+    columns->transaction_id[row]    = record->transaction_id;
+    columns->seller_id[row]         = record->seller_id;
+    columns->buyer_id[row]          = record->buyer_id;
+    columns->energy_amount[row]     = record->energy_amount;
+    columns->price_per_unit[row]    = record->price_per_unit;
+    columns->transaction_money[row] = record->transaction_money;
+    columns->packed_time[row]       = record->packed_time;
+    return SUCCESS;
 }
 
-Record *division(Record *head)
-{
-    Record *slow=head,*fast=head->next_record;
-    while(fast!=NULL && fast->next_record!=NULL)
-    {
-        slow=slow->next_record;
-        fast=fast->next_record->next_record;
-    }
-    return slow;
+void free_record_columns(Record_columns *columns) {
+    free(columns->transaction_id);
+    free(columns->seller_id);
+    free(columns->buyer_id);
+    free(columns->energy_amount);
+    free(columns->price_per_unit);
+    free(columns->transaction_money);
+    free(columns->packed_time);
+    initialise_record_columns(columns);
 }
 
-Record *sort_records(Record *head, key sorting_key) {
-    if (!head || !head->next_record) return head;
+// Sum of values[i] over the rows whose ids[i] equals id. The rows are processed
+// COLUMN_LANES at a time into independent accumulators and the comparison is
+// turned into a select, so the loop has no branches and the compiler can keep
+// every lane in one SIMD register.
+float column_masked_sum(const int *ids, const float *values, size_t count, int id, size_t *matches) {
+    float lane_sum[COLUMN_LANES]   = {0};
+    int   lane_count[COLUMN_LANES] = {0};
+    size_t row = 0;
+
+    for (; row + COLUMN_LANES <= count; row += COLUMN_LANES) {
+        for (int lane = 0; lane < COLUMN_LANES; lane++) {
+            int hit = ids[row + lane] == id;
+            lane_sum[lane]   += hit ? values[row + lane] : 0.0f;
+            lane_count[lane] += hit;
+        }
+    }
 
-    Record *mid = division(head);
-    Record *second_half = mid->next_record;
-    mid->next_record = NULL;
+    float  sum = 0.0f;
+    size_t hits = 0;
+    for (int lane = 0; lane < COLUMN_LANES; lane++) {
+        sum  += lane_sum[lane];
+        hits += lane_count[lane];
+    }
+    for (; row < count; row++) { // rows left over after the last full block
+        if (ids[row] == id) {
+            sum += values[row];
+            hits++;
+        }
+    }
+    if (matches) *matches = hits;
+    return sum;
+}
 
-    Record *left_sorted = sort_records(head, sorting_key);
-    Record *right_sorted = sort_records(second_half, sorting_key);
+// Row of the largest value, the newest row wins a tie. The maximum itself is
+// found with the same lane scheme as column_masked_sum, the row is then found
+// by a second comparison-only pass.
+size_t column_index_of_maximum(const float *values, size_t count) {
+    if (count == 0) return 0;
+
+    float lane_max[COLUMN_LANES];
+    for (int lane = 0; lane < COLUMN_LANES; lane++) {
+        lane_max[lane] = values[0];
+    }
+    size_t row = 0;
+    for (; row + COLUMN_LANES <= count; row += COLUMN_LANES) {
+        for (int lane = 0; lane < COLUMN_LANES; lane++) {
+            float value = values[row + lane];
+            lane_max[lane] = value > lane_max[lane] ? value : lane_max[lane];
+        }
+    }
+    float maximum = lane_max[0];
+    for (int lane = 1; lane < COLUMN_LANES; lane++) {
+        maximum = lane_max[lane] > maximum ? lane_max[lane] : maximum;
+    }
+    for (; row < count; row++) {
+        maximum = values[row] > maximum ? values[row] : maximum;
+    }
+
+    size_t index = count - 1;
+    while (values[index] != maximum) {
+        index--;
+    }
+    return index;
+}
+
+// Initialize the hash table within the Database structure
+void initialise_the_hashtable(Database *db) {
+    initialise_hash_index(&db->tid_index); // no slots are allocated until the first transaction
+}
+
+// Mixes all bits of the key into all bits of the hash (the finaliser of MurmurHash3),
+// so that consecutive IDs end up far apart and the low bits can be used as the slot
+unsigned long hash_key(uint64_t key) {
+    uint64_t hash = key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return (unsigned long)hash;
+}
+
+// One 64 bit key for a seller and buyer pair: the seller ID in the high half and
+// the buyer ID in the low half, so pair keys order like (SID, BID) and never overflow
+uint64_t pair_key(int SID, int BID) {
+    return ((uint64_t)(uint32_t)SID << 32) | (uint32_t)BID;
+}
+
+void initialise_hash_index(Hash_index *index) {
+    index->slots    = NULL;
+    index->capacity = 0;
+    index->count    = 0;
+}
+
+// Find the slot holding the key, NULL when the key is not in the index.
+// Linear probing keeps the whole search inside one or two cache lines.
+Hash_slot* hash_index_find(const Hash_index *index, uint64_t key) {
+    if (index->count == 0) return NULL;
+
+    size_t mask = index->capacity - 1;
+    size_t position = hash_key(key) & mask;
+    while (index->slots[position].key != 0) {
+        if (index->slots[position].key == key) {
+            return &index->slots[position];
+        }
+        position = (position + 1) & mask;
+    }
+    return NULL;
+}
+
+// Place a key that is known to be absent, the index must have a free slot
+static void hash_index_place(Hash_index *index, uint64_t key, void *node) {
+    size_t mask = index->capacity - 1;
+    size_t position = hash_key(key) & mask;
+    while (index->slots[position].key != 0) {
+        position = (position + 1) & mask;
+    }
+    index->slots[position].key  = key;
+    index->slots[position].node = node;
+    index->count++;
+}
+
+// Double the number of slots and move every key to its slot in the new table
+static status_code hash_index_grow(Hash_index *index) {
+    size_t     capacity = index->capacity ? index->capacity * 2 : HASH_INDEX_FIRST_CAPACITY;
+    Hash_slot *old_slots = index->slots;
+    size_t     old_capacity = index->capacity;
+
+    Hash_slot *slots = (Hash_slot*)calloc(capacity, sizeof(Hash_slot));
+    if (!slots) {
+        printf("Memory allocation failed!\n");
+        return FAILURE;
+    }
+    index->slots    = slots;
+    index->capacity = capacity;
+    index->count    = 0;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i].key != 0) {
+            hash_index_place(index, old_slots[i].key, old_slots[i].node);
+        }
+    }
+    free(old_slots);
+    return SUCCESS;
+}
+
+// Insert the key or replace the node stored with it, in one walk of the probe
+// sequence that stops at the key or at the first empty slot. The index grows before
+// it is 70% full, which keeps the probe sequences short.
+status_code hash_index_insert(Hash_index *index, uint64_t key, void *node) {
+    if ((index->count + 1) * 10 > index->capacity * 7) {
+        if (hash_index_grow(index) == FAILURE) {
+            return FAILURE;
+        }
+    }
+    size_t mask = index->capacity - 1;
+    size_t position = hash_key(key) & mask;
+    while (index->slots[position].key != 0 && index->slots[position].key != key) {
+        position = (position + 1) & mask;
+    }
+    if (index->slots[position].key == 0) {
+        index->slots[position].key = key;
+        index->count++;
+    }
+    index->slots[position].node = node;
+    return SUCCESS;
+}
+
+void free_hash_index(Hash_index *index) {
+    free(index->slots);
+    initialise_hash_index(index);
+}
+
+// Store the transaction ID in the transaction ID index together with its Record.
+// Records never move once they are allocated from the record slab and sorting
+// only relinks next_record, so the stored pointer stays valid across sorts.
+// Empty the slot of the key. The entries after it in the same probe run are moved
+// back into the gap when their home slot allows it, so a later search does not stop
+// early at the emptied slot.
+void hash_index_remove(Hash_index *index, uint64_t key) {
+    Hash_slot *slot = hash_index_find(index, key);
+    if (!slot) return;
+
+    size_t mask = index->capacity - 1;
+    size_t gap = (size_t)(slot - index->slots);
+    size_t position = gap;
+    while (index->slots[position = (position + 1) & mask].key != 0) {
+        size_t home = hash_key(index->slots[position].key) & mask;
+        if (((position - home) & mask) >= ((position - gap) & mask)) {
+            index->slots[gap] = index->slots[position]; // its home is not between the gap and itself
+            gap = position;
+        }
+    }
+    index->slots[gap].key  = 0;
+    index->slots[gap].node = NULL;
+    index->count--;
+}
+
+status_code storing_the_transactionID_along_with_hash(Database *db, int id, Record *record) {
+    return hash_index_insert(&db->tid_index, (unsigned long)id, record);
+}
+
+// Record of the transaction with this ID in O(1), NULL when there is no such transaction
+Record* get_transaction(Database *db, int TID) {
+    if (!db) return NULL;
+    Hash_slot *slot = hash_index_find(&db->tid_index, (unsigned long)TID);
+    return slot ? (Record*)slot->node : NULL;
+}
+
+// Time index: a sorted array of (packed time, record) pairs. Transactions mostly
+// arrive in time order, so an insert is nearly always an append; an out of order
+// insert moves the entries after it by one with a single memmove.
+
+// Packs a valid time stamp into one integer whose order is the order of time:
+// 7 bits of years since MIN_YEAR, 4 bits of month, 5 of date, 5 of hours, 6 of minutes.
+// Records only store this form, so comparing two times is one integer comparison
+// and the fields are only unpacked again to display them.
+uint32_t pack_time_stamp(time_stamp time) {
+    return ((uint32_t)(time.year - MIN_YEAR) << 20) | ((uint32_t)time.month << 16) |
+           ((uint32_t)time.date << 11) | ((uint32_t)time.hours << 6) | (uint32_t)time.minutes;
+}
+
+time_stamp unpack_time_stamp(uint32_t packed_time) {
+    time_stamp time;
+    time_fill(&time, (int)((packed_time >> 11) & 31), (int)((packed_time >> 16) & 15),
+              MIN_YEAR + (int)(packed_time >> 20), (int)((packed_time >> 6) & 31), (int)(packed_time & 63));
+    return time;
+}
+
+void initialise_time_index(Time_index *index) {
+    index->entries  = NULL;
+    index->count    = 0;
+    index->capacity = 0;
+}
+
+// Position of the first entry whose key is not smaller than time_key
+size_t time_index_lower_bound(const Time_index *index, uint32_t time_key) {
+    size_t low = 0, high = index->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (index->entries[middle].time_key < time_key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Make room for one more entry
+static status_code time_index_reserve(Time_index *index) {
+    if (index->count == index->capacity) {
+        size_t capacity = index->capacity ? index->capacity * 2 : TIME_INDEX_FIRST_CAPACITY;
+        Time_index_entry *entries = (Time_index_entry*)realloc(index->entries, capacity * sizeof(Time_index_entry));
+        if (!entries) {
+            printf("Memory allocation failed!\n");
+            return FAILURE;
+        }
+        index->entries  = entries;
+        index->capacity = capacity;
+    }
+    return SUCCESS;
+}
+
+status_code time_index_insert(Time_index *index, uint32_t time_key, Record *record) {
+    if (time_index_reserve(index) == FAILURE) {
+        return FAILURE;
+    }
+
+    size_t position = index->count;
+    if (position > 0 && index->entries[position - 1].time_key > time_key) {
+        position = time_index_lower_bound(index, time_key + 1); // after the records with the same time
+        memmove(&index->entries[position + 1], &index->entries[position],
+                (index->count - position) * sizeof(Time_index_entry));
+    }
+    index->entries[position].time_key = time_key;
+    index->entries[position].record   = record;
+    index->count++;
+    return SUCCESS;
+}
+
+// Add the entry at the end whatever its time, for loads that insert many records
+// at once and put them in order with one time_index_sort_from afterwards
+status_code time_index_append(Time_index *index, uint32_t time_key, Record *record) {
+    if (time_index_reserve(index) == FAILURE) {
+        return FAILURE;
+    }
+    index->entries[index->count].time_key = time_key;
+    index->entries[index->count].record   = record;
+    index->count++;
+    return SUCCESS;
+}
+
+// Put the entries appended after the first `sorted` ones in order: the appended
+// entries are merge sorted on their own and then merged into the sorted part from
+// the back. Both merges are stable, so equal times stay in insertion order.
+status_code time_index_sort_from(Time_index *index, size_t sorted) {
+    size_t appended = index->count - sorted;
+    if (appended == 0) return SUCCESS;
+
+    Time_index_entry *temp = (Time_index_entry*)malloc(appended * sizeof(Time_index_entry));
+    if (!temp) {
+        printf("Memory allocation failed!\n");
+        return FAILURE;
+    }
+    Time_index_entry *from = index->entries + sorted, *to = temp;
+    for (size_t width = 1; width < appended; width *= 2) {
+        for (size_t low = 0; low < appended; low += 2 * width) {
+            size_t middle = low + width < appended ? low + width : appended;
+            size_t high   = low + 2 * width < appended ? low + 2 * width : appended;
+            size_t left = low, right = middle, out = low;
+            while (left < middle && right < high) {
+                to[out++] = from[right].time_key < from[left].time_key ? from[right++] : from[left++];
+            }
+            while (left < middle) to[out++] = from[left++];
+            while (right < high)  to[out++] = from[right++];
+        }
+        Time_index_entry *swap = from;
+        from = to;
+        to   = swap;
+    }
+    if (from != temp) {
+        memcpy(temp, from, appended * sizeof(Time_index_entry));
+    }
+
+    // merge from the back, an appended entry goes after sorted entries with the same time
+    size_t left = sorted, right = appended, out = index->count;
+    while (right > 0) {
+        if (left > 0 && index->entries[left - 1].time_key > temp[right - 1].time_key) {
+            index->entries[--out] = index->entries[--left];
+        } else {
+            index->entries[--out] = temp[--right];
+        }
+    }
+    free(temp);
+    return SUCCESS;
+}
+
+// Remove the entry of a record, time_key must be the key it was inserted with
+void time_index_remove(Time_index *index, uint32_t time_key, Record *record) {
+    if (index->count > 0 && index->entries[index->count - 1].record == record) {
+        index->count--; // the newest entry, also when it was only appended
+        return;
+    }
+    size_t position = time_index_lower_bound(index, time_key);
+    while (position < index->count && index->entries[position].record != record) {
+        position++;
+    }
+    if (position == index->count) return;
+    memmove(&index->entries[position], &index->entries[position + 1],
+            (index->count - position - 1) * sizeof(Time_index_entry));
+    index->count--;
+}
+
+void free_time_index(Time_index *index) {
+    free(index->entries);
+    initialise_time_index(index);
+}
+
+// Iterator over the records between two time stamps (both included, in either
+// order) in time order. Finding the range costs two binary searches, the records
+// inside it are then handed out one by one. Invalid time stamps give an empty range.
+Time_range_iterator records_between_time(Database *db, time_stamp t1, time_stamp t2) {
+    Time_range_iterator range = {NULL, NULL};
+    if (!db || !is_time_input_valid(t1) || !is_time_input_valid(t2)) {
+        return range;
+    }
+    uint32_t low  = pack_time_stamp(t1);
+    uint32_t high = pack_time_stamp(t2);
+    if (low > high) {
+        uint32_t temp = low;
+        low  = high;
+        high = temp;
+    }
+    const Time_index *index = &db->time_index;
+    range.next = index->entries + time_index_lower_bound(index, low);
+    range.end  = index->entries + time_index_lower_bound(index, high + 1);
+    return range;
+}
+
+Record* next_record_in_time_range(Time_range_iterator *range) {
+    if (range->next == range->end) return NULL;
+    return (range->next++)->record;
+}
+
+// Number of records between two time stamps without visiting any of them
+size_t count_records_between_time(Database *db, time_stamp t1, time_stamp t2) {
+    Time_range_iterator range = records_between_time(db, t1, t2);
+    return (size_t)(range.end - range.next);
+}
+
+// Energy index: a skip list whose nodes come from their own slabs. Every node is
+// on level 0 and on each further level with probability 1/4, so finding the place
+// of an energy takes O(log n) steps, and because the list runs from the largest
+// energy down, the maximum, the top N and every record above X are a walk from the
+// head that stops after the records it reports. A node only holds the forward
+// pointers of its own levels, three in four nodes have just one, and there is one
+// slab for every node size.
+void initialise_energy_index(Energy_index *index) {
+    index->head         = NULL;
+    index->level        = 1;
+    index->count        = 0;
+    index->random_state = 2463534242u;
+    for (int i = 0; i < ENERGY_INDEX_MAX_LEVEL; i++) {
+        initialise_slab(&index->node_slabs[i],
+                        offsetof(Energy_index_node, forward) + (size_t)(i + 1) * sizeof(Energy_index_node*));
+    }
+}
+
+// A node with forward pointers for level levels, all of them NULL
+static Energy_index_node* energy_index_alloc_node(Energy_index *index, int level) {
+    Energy_index_node *node = (Energy_index_node*)slab_alloc(&index->node_slabs[level - 1]);
+    if (!node) return NULL;
+    node->level = level;
+    for (int i = 0; i < level; i++) {
+        node->forward[i] = NULL;
+    }
+    return node;
+}
+
+// True when the node comes before a record with this energy and transaction ID
+static bool energy_index_precedes(const Energy_index_node *node, float energy_amount, int transaction_id) {
+    return node->energy_amount > energy_amount ||
+           (node->energy_amount == energy_amount && node->record->transaction_id < transaction_id);
+}
+
+// Fill update[level] with the last node on each level in front of the key
+static void energy_index_search(Energy_index *index, float energy_amount, int transaction_id,
+                                Energy_index_node *update[ENERGY_INDEX_MAX_LEVEL]) {
+    Energy_index_node *node = index->head;
+    for (int level = index->level - 1; level >= 0; level--) {
+        while (node->forward[level] && energy_index_precedes(node->forward[level], energy_amount, transaction_id)) {
+            node = node->forward[level];
+        }
+        update[level] = node;
+    }
+}
+
+static int energy_index_random_level(Energy_index *index) {
+    int level = 1;
+    while (level < ENERGY_INDEX_MAX_LEVEL) {
+        uint32_t x = index->random_state; // xorshift32
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        index->random_state = x;
+        if (x & 3) break;
+        level++;
+    }
+    return level;
+}
+
+status_code energy_index_insert(Energy_index *index, Record *record) {
+    if (!index->head) {
+        index->head = energy_index_alloc_node(index, ENERGY_INDEX_MAX_LEVEL);
+        if (!index->head) return FAILURE;
+    }
+    int level = energy_index_random_level(index);
+    Energy_index_node *node = energy_index_alloc_node(index, level);
+    if (!node) return FAILURE;
+
+    Energy_index_node *update[ENERGY_INDEX_MAX_LEVEL];
+    energy_index_search(index, record->energy_amount, record->transaction_id, update);
+    for (int i = index->level; i < level; i++) {
+        update[i] = index->head;
+    }
+    if (level > index->level) index->level = level;
+
+    node->energy_amount = record->energy_amount;
+    node->record        = record;
+    for (int i = 0; i < level; i++) {
+        node->forward[i] = update[i]->forward[i];
+        update[i]->forward[i] = node;
+    }
+    index->count++;
+    return SUCCESS;
+}
+
+// Remove the node of a record, energy_amount must be the energy it was inserted with
+void energy_index_remove(Energy_index *index, float energy_amount, Record *record) {
+    if (!index->head) return;
+    Energy_index_node *update[ENERGY_INDEX_MAX_LEVEL];
+    energy_index_search(index, energy_amount, record->transaction_id, update);
+    Energy_index_node *node = update[0]->forward[0];
+    if (!node || node->record != record) return;
+
+    for (int i = 0; i < node->level; i++) {
+        update[i]->forward[i] = node->forward[i];
+    }
+    while (index->level > 1 && !index->head->forward[index->level - 1]) {
+        index->level--;
+    }
+    slab_free(&index->node_slabs[node->level - 1], node);
+    index->count--;
+}
+
+void free_energy_index(Energy_index *index) {
+    for (int i = 0; i < ENERGY_INDEX_MAX_LEVEL; i++) {
+        slab_release(&index->node_slabs[i]);
+    }
+    initialise_energy_index(index);
+}
+
+// Node of the record with the most energy, NULL when the index is empty
+const Energy_index_node* energy_index_first(const Energy_index *index) {
+    return index->head ? index->head->forward[0] : NULL;
+}
+
+Record* record_with_maximum_energy(Database *db) {
+    const Energy_index_node *first = energy_index_first(&db->energy_index);
+    return first ? first->record : NULL;
+}
+
+// Write the n records with the most energy to out, largest first, and return how many were written
+size_t records_with_most_energy(Database *db, size_t n, Record **out) {
+    size_t written = 0;
+    for (const Energy_index_node *node = energy_index_first(&db->energy_index); node && written < n; node = node->forward[0]) {
+        out[written++] = node->record;
+    }
+    return written;
+}
+
+// Iterator over the records with more energy than the minimum, largest first
+Energy_iterator records_above_energy(Database *db, float minimum) {
+    Energy_iterator iterator = {energy_index_first(&db->energy_index), minimum};
+    return iterator;
+}
+
+Record* next_record_above_energy(Energy_iterator *iterator) {
+    const Energy_index_node *node = iterator->next;
+    if (!node || !(node->energy_amount > iterator->minimum)) return NULL;
+    iterator->next = node->forward[0];
+    return node->record;
+}
+
+// Bulk loader: the file is read in BULK_LOAD_BUFFER_SIZE blocks, every line is
+// parsed in place without allocating, and rows are handled BULK_LOAD_BATCH_ROWS at
+// a time: one pass validates them, one pass checks and claims their transaction
+// IDs in the bitmap and one pass stores them. Rejected rows are counted by reason
+// instead of printing an error for each, and the time index is put in order once
+// at the end instead of on every insert.
+//
+// A line holds ten numbers, separated by commas, spaces, tabs, '/' or ':':
+//     TID, SID, BID, energy amount, price per unit, DD, MM, YYYY, HH, MM
+// Blank lines are skipped, and so is the first other line when it is a header (it does
+// not parse and does not start with a digit). Every other line that does not parse is
+// rejected as malformed.
+
+static bool is_bulk_separator(char c) {
+    return c == ',' || c == ' ' || c == '\t' || c == '/' || c == ':' || c == '\r';
+}
+
+static const char* skip_bulk_separators(const char *cursor, const char *end) {
+    while (cursor < end && is_bulk_separator(*cursor)) cursor++;
+    return cursor;
+}
+
+// Read a whole number of at most 9 digits
+static bool parse_bulk_int(const char **cursor, const char *end, int *value) {
+    const char *p = skip_bulk_separators(*cursor, end);
+    int digits = 0, number = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (++digits > 9) return false;
+        number = number * 10 + (*p++ - '0');
+    }
+    if (digits == 0) return false;
+    *cursor = p;
+    *value  = number;
+    return true;
+}
+
+// Read a decimal number like 57.9 or 20 (at most 9 digits on either side of the point)
+static bool parse_bulk_decimal(const char **cursor, const char *end, float *value) {
+    int whole = 0;
+    if (!parse_bulk_int(cursor, end, &whole)) return false;
+    double number = whole;
+    const char *p = *cursor;
+    if (p < end && *p == '.') {
+        p++;
+        int digits = 0, fraction = 0;
+        double scale = 1.0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (++digits > 9) return false;
+            fraction = fraction * 10 + (*p++ - '0');
+            scale *= 10.0;
+        }
+        number += fraction / scale;
+    }
+    *cursor = p;
+    *value  = (float)number;
+    return true;
+}
+
+// Parse one line (without its newline) into row, false when it is not ten numbers
+bool parse_bulk_row(const char *line, const char *end, Bulk_row *row) {
+    const char *cursor = line;
+    bool parsed = parse_bulk_int(&cursor, end, &row->transaction_id) &&
+                  parse_bulk_int(&cursor, end, &row->seller_id)      &&
+                  parse_bulk_int(&cursor, end, &row->buyer_id)       &&
+                  parse_bulk_decimal(&cursor, end, &row->energy_amount)  &&
+                  parse_bulk_decimal(&cursor, end, &row->price_per_unit) &&
+                  parse_bulk_int(&cursor, end, &row->time.date)      &&
+                  parse_bulk_int(&cursor, end, &row->time.month)     &&
+                  parse_bulk_int(&cursor, end, &row->time.year)      &&
+                  parse_bulk_int(&cursor, end, &row->time.hours)     &&
+                  parse_bulk_int(&cursor, end, &row->time.minutes);
+    return parsed && skip_bulk_separators(cursor, end) == end;
+}
+
+static void reject_bulk_line(Bulk_load_summary *summary, size_t *reason, size_t line) {
+    (*reason)++;
+    if (summary->first_rejected_line == 0 || line < summary->first_rejected_line) {
+        summary->first_rejected_line = line;
+    }
+}
+
+static void load_bulk_batch(Database *db, Bulk_row *rows, size_t count, Bulk_load_summary *summary) {
+    bool    accepted[BULK_LOAD_BATCH_ROWS];
+    int32_t ids[3 * BULK_LOAD_BATCH_ROWS];
+    uint8_t valid_ids[3 * BULK_LOAD_BATCH_ROWS];
+
+    // check digits of the whole batch at once, TID, SID and BID of each row side by side
+    for (size_t i = 0; i < count; i++) {
+        ids[3 * i]     = rows[i].transaction_id;
+        ids[3 * i + 1] = rows[i].seller_id;
+        ids[3 * i + 2] = rows[i].buyer_id;
+    }
+    verhoeff_validate_batch(ids, valid_ids, 3 * count);
+
+    // the same checks as validity_checker, without a message for every row
+    for (size_t i = 0; i < count; i++) {
+        Bulk_row *row = &rows[i];
+        accepted[i] = false;
+        if (!is_time_input_valid(row->time)) {
+            reject_bulk_line(summary, &summary->invalid_time, row->line);
+        } else if (!(valid_ids[3 * i] && valid_ids[3 * i + 1] && valid_ids[3 * i + 2])) {
+            reject_bulk_line(summary, &summary->invalid_id, row->line);
+        } else if (!is_energy_input_valid(row->energy_amount) || !is_priceperunit_input_valid(row->price_per_unit)) {
+            reject_bulk_line(summary, &summary->invalid_amount, row->line);
+        } else {
+            accepted[i] = true;
+        }
+    }
+
+    // claiming the ID in the bitmap also catches a repeat later in the same file
+    for (size_t i = 0; i < count; i++) {
+        if (accepted[i] && (snapshot_contains(&db->snapshot, rows[i].transaction_id) ||
+                            transaction_id_bitmap_test_and_set(db, rows[i].transaction_id))) {
+            accepted[i] = false;
+            reject_bulk_line(summary, &summary->duplicate_id, rows[i].line);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!accepted[i]) continue;
+        Bulk_row *row = &rows[i];
+        if (add_validated_record(db, row->transaction_id, row->seller_id, row->buyer_id, row->energy_amount,
+                                 row->price_per_unit, pack_time_stamp(row->time), true, &db->record_list) == SUCCESS) {
+            summary->loaded++;
+        } else {
+            transaction_id_bitmap_clear(db, row->transaction_id);
+            reject_bulk_line(summary, &summary->failed, row->line);
+        }
+    }
+}
+
+// Load every transaction of the file into the Database and describe what happened
+// to each line in summary. FAILURE means the file could not be read at all.
+status_code bulk_load_transactions(Database *db, const char *path, Bulk_load_summary *summary) {
+    memset(summary, 0, sizeof(*summary));
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        printf("Could not open %s\n", path);
+        return FAILURE;
+    }
+    char     *buffer = (char*)malloc(BULK_LOAD_BUFFER_SIZE);
+    Bulk_row *rows   = (Bulk_row*)malloc(BULK_LOAD_BATCH_ROWS * sizeof(Bulk_row));
+    if (!buffer || !rows) {
+        printf("Memory allocation failed!\n");
+        free(buffer);
+        free(rows);
+        fclose(file);
+        return FAILURE;
+    }
+
+    size_t sorted_time_entries = db->time_index.count;
+    size_t filled = 0, batched = 0;
+    bool   end_of_file = false, skipping_long_line = false, header_allowed = true;
+    while (!end_of_file || filled > 0) {
+        if (!end_of_file) {
+            size_t read = fread(buffer + filled, 1, BULK_LOAD_BUFFER_SIZE - filled, file);
+            filled += read;
+            end_of_file = read == 0;
+        }
+
+        const char *start = buffer, *end = buffer + filled;
+        for (;;) {
+            const char *newline = (const char*)memchr(start, '\n', (size_t)(end - start));
+            if (!newline) {
+                if (!end_of_file || start == end) break;
+                newline = end; // the last line has no newline
+            }
+            if (skipping_long_line) {
+                skipping_long_line = false; // the rest of a line that did not fit in the buffer
+            } else {
+                summary->lines++;
+                const char *first = skip_bulk_separators(start, newline);
+                if (first < newline) {
+                    Bulk_row *row = &rows[batched];
+                    row->line = summary->lines;
+                    if (parse_bulk_row(start, newline, row)) {
+                        if (++batched == BULK_LOAD_BATCH_ROWS) {
+                            load_bulk_batch(db, rows, batched, summary);
+                            batched = 0;
+                        }
+                    } else if (!header_allowed || (*first >= '0' && *first <= '9')) {
+                        reject_bulk_line(summary, &summary->malformed, summary->lines);
+                    }
+                    header_allowed = false; // only the first line that is not blank can be a header
+                }
+            }
+            start = newline < end ? newline + 1 : end;
+        }
+
+        if (start == buffer && filled == BULK_LOAD_BUFFER_SIZE) {
+            // a single line fills the whole buffer, drop what we have of it
+            if (!skipping_long_line) {
+                summary->lines++;
+                reject_bulk_line(summary, &summary->malformed, summary->lines);
+                skipping_long_line = true;
+                header_allowed     = false;
+            }
+            start = end;
+        }
+        filled = (size_t)(end - start);
+        memmove(buffer, start, filled);
+    }
+    if (batched > 0) {
+        load_bulk_batch(db, rows, batched, summary);
+    }
+
+    status_code done = ferror(file) ? FAILURE : SUCCESS;
+    if (time_index_sort_from(&db->time_index, sorted_time_entries) == FAILURE) {
+        done = FAILURE;
+    }
+    free(buffer);
+    free(rows);
+    fclose(file);
+    return done;
+}
+
+void display_bulk_load_summary(const char *path, const Bulk_load_summary *summary) {
+    size_t rejected = summary->malformed + summary->invalid_time + summary->invalid_id +
+                      summary->invalid_amount + summary->duplicate_id + summary->failed;
+    printf("Loaded %zu transactions from %s (%zu lines, %zu rejected)\n",
+           summary->loaded, path, summary->lines, rejected);
+    if (rejected == 0) return;
+    printf("  malformed lines       : %zu\n", summary->malformed);
+    printf("  invalid time          : %zu\n", summary->invalid_time);
+    printf("  invalid IDs           : %zu\n", summary->invalid_id);
+    printf("  invalid energy/price  : %zu\n", summary->invalid_amount);
+    printf("  duplicate IDs         : %zu\n", summary->duplicate_id);
+    printf("  failed inserts        : %zu\n", summary->failed);
+    printf("  first rejected line   : %zu\n", summary->first_rejected_line);
+}
+
+// Write-ahead log: a file that starts with WAL_MAGIC and then holds one entry per
+// insert or update, in the order they happened:
+//     insert: 'I', TID, SID, BID, energy, price, packed time, checksum   (29 bytes)
+//     update: 'U', TID, energy, price, packed time, checksum             (21 bytes)
+// Every field after the tag is 4 bytes in the byte order of this machine, and the
+// checksum (FNV-1a) covers the bytes in front of it. Entries are collected in
+// memory and made durable together (group commit): one write and one fsync once
+// sync_bytes are waiting or the oldest of them is sync_interval_ms old, checked
+// when an entry is added, and the menu syncs whatever is waiting before it waits
+// for input. At most that much is lost when the process dies. An insert is logged
+// after every other step of it that can fail, an update before it changes the
+// Database, and either one is undone when its entry cannot be written.
+#define WAL_MAGIC       "ETRLOG01"
+#define WAL_MAGIC_SIZE  8
+#define WAL_INSERT_SIZE 29
+#define WAL_UPDATE_SIZE 21
+
+void initialise_write_ahead_log(Write_ahead_log *log) {
+    log->fd               = -1;
+    log->path             = NULL;
+    log->sync_bytes       = WAL_DEFAULT_SYNC_BYTES;
+    log->sync_interval_ms = WAL_DEFAULT_SYNC_MS;
+    log->unsynced_bytes   = 0;
+    log->buffered         = 0;
+    log->broken           = false;
+    clock_gettime(CLOCK_MONOTONIC, &log->last_sync);
+}
+
+static uint32_t wal_checksum(const uint8_t *bytes, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint8_t* wal_put(uint8_t *out, const void *field) {
+    memcpy(out, field, 4);
+    return out + 4;
+}
+
+static status_code wal_write_all(int fd, const uint8_t *bytes, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            printf("Writing the transaction log failed!\n");
+            return FAILURE;
+        }
+        bytes  += written;
+        length -= (size_t)written;
+    }
+    return SUCCESS;
+}
+
+// Write out the buffered entries, and fsync the file when sync is set. When either
+// fails the file is cut back to where it was and the entries stay buffered, so the
+// next sync writes them again and no torn entry is left in front of them. A file
+// that cannot be cut back marks the log as broken and nothing more is written to it.
+static status_code wal_write_buffer(Write_ahead_log *log, bool sync) {
+    if (log->broken) {
+        printf("The transaction log is broken, nothing more is written to it\n");
+        return FAILURE;
+    }
+    off_t start = lseek(log->fd, 0, SEEK_CUR);
+    status_code done = wal_write_all(log->fd, log->buffer, log->buffered);
+    if (done == SUCCESS && sync && fsync(log->fd) != 0) {
+        printf("Syncing the transaction log failed!\n");
+        done = FAILURE;
+    }
+    if (done == FAILURE) {
+        if (start < 0 || ftruncate(log->fd, start) != 0 || lseek(log->fd, start, SEEK_SET) < 0) {
+            log->broken = true;
+        }
+        return FAILURE;
+    }
+    log->buffered = 0;
+    return SUCCESS;
+}
+
+// Write out the buffered entries and fsync the file: the group commit
+status_code sync_write_ahead_log(Write_ahead_log *log) {
+    if (log->fd < 0) return SUCCESS;
+    if (wal_write_buffer(log, log->unsynced_bytes > 0) == FAILURE) {
+        return FAILURE; // everything stays waiting for the next sync
+    }
+    log->unsynced_bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &log->last_sync);
+    return SUCCESS;
+}
+
+static status_code wal_append(Write_ahead_log *log, uint8_t *entry, size_t length) {
+    if (log->fd < 0) return SUCCESS;
+
+    uint32_t checksum = wal_checksum(entry, length - 4);
+    memcpy(entry + length - 4, &checksum, 4);
+    if (log->buffered + length > WAL_BUFFER_SIZE && wal_write_buffer(log, false) == FAILURE) {
+        return FAILURE; // the buffered entries are written by a later sync, this one is not taken
+    }
+    memcpy(log->buffer + log->buffered, entry, length);
+    log->buffered       += length;
+    log->unsynced_bytes += length;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long waited_ms = (long)(now.tv_sec - log->last_sync.tv_sec) * 1000 +
+                     (now.tv_nsec - log->last_sync.tv_nsec) / 1000000;
+    if ((log->unsynced_bytes >= log->sync_bytes || waited_ms >= log->sync_interval_ms) &&
+        sync_write_ahead_log(log) == FAILURE) {
+        log->buffered       -= length; // the caller undoes its change, so its entry goes as well
+        log->unsynced_bytes -= length;
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+status_code log_inserted_record(Write_ahead_log *log, const Record *record) {
+    uint8_t entry[WAL_INSERT_SIZE];
+    uint8_t *out = entry;
+    *out++ = 'I';
+    out = wal_put(out, &record->transaction_id);
+    out = wal_put(out, &record->seller_id);
+    out = wal_put(out, &record->buyer_id);
+    out = wal_put(out, &record->energy_amount);
+    out = wal_put(out, &record->price_per_unit);
+    out = wal_put(out, &record->packed_time);
+    return wal_append(log, entry, sizeof(entry));
+}
+
+status_code log_updated_record(Write_ahead_log *log, const Record *record) {
+    uint8_t entry[WAL_UPDATE_SIZE];
+    uint8_t *out = entry;
+    *out++ = 'U';
+    out = wal_put(out, &record->transaction_id);
+    out = wal_put(out, &record->energy_amount);
+    out = wal_put(out, &record->price_per_unit);
+    out = wal_put(out, &record->packed_time);
+    return wal_append(log, entry, sizeof(entry));
+}
+
+// Apply every complete entry of the log in buffer through the normal insert and
+// update functions and return the number of bytes they take. Reading stops at the
+// first entry that is cut short or fails its checksum: the tail of a crash.
+static size_t replay_write_ahead_log(Database *db, const uint8_t *bytes, size_t length, size_t *applied) {
+    size_t offset = WAL_MAGIC_SIZE;
+    while (offset < length) {
+        size_t size = bytes[offset] == 'I' ? WAL_INSERT_SIZE : bytes[offset] == 'U' ? WAL_UPDATE_SIZE : 0;
+        if (size == 0 || offset + size > length) break;
+        uint32_t checksum;
+        memcpy(&checksum, bytes + offset + size - 4, 4);
+        if (checksum != wal_checksum(bytes + offset, size - 4)) break;
+
+        int      TID, SID = 0, BID = 0;
+        float    EA, PPU;
+        uint32_t time_key;
+        const uint8_t *in = bytes + offset + 1;
+        memcpy(&TID, in, 4);
+        in += 4;
+        if (bytes[offset] == 'I') {
+            memcpy(&SID, in, 4);
+            memcpy(&BID, in + 4, 4);
+            in += 8;
+        }
+        memcpy(&EA, in, 4);
+        memcpy(&PPU, in + 4, 4);
+        memcpy(&time_key, in + 8, 4);
+        time_stamp samay = unpack_time_stamp(time_key);
+
+        status_code done = bytes[offset] == 'I'
+            ? insert_record_into_record_list(db, TID, SID, BID, EA, PPU, &samay, &db->record_list)
+            : update_existing_transaction(db, TID, EA, PPU, samay);
+        if (done == SUCCESS) (*applied)++;
+        offset += size;
+    }
+    return offset;
+}
+
+// Open (or create) the log at path, replay what it holds into the Database and log
+// every following insert and update to it. A cut short tail is cut off the file.
+status_code open_write_ahead_log(Database *db, const char *path, size_t sync_bytes, long sync_interval_ms) {
+    Write_ahead_log *log = &db->log;
+    close_write_ahead_log(log);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        printf("Could not open the transaction log %s\n", path);
+        return FAILURE;
+    }
+    off_t length = lseek(fd, 0, SEEK_END);
+    uint8_t *bytes = length > 0 ? (uint8_t*)malloc((size_t)length) : NULL;
+    if (length < 0 || (length > 0 && !bytes)) {
+        printf("Could not read the transaction log %s\n", path);
+        free(bytes);
+        close(fd);
+        return FAILURE;
+    }
+    size_t have = 0;
+    while (have < (size_t)length) {
+        ssize_t got = pread(fd, bytes + have, (size_t)length - have, (off_t)have);
+        if (got <= 0) break;
+        have += (size_t)got;
+    }
+
+    size_t valid = WAL_MAGIC_SIZE, applied = 0;
+    if (have >= WAL_MAGIC_SIZE && memcmp(bytes, WAL_MAGIC, WAL_MAGIC_SIZE) == 0) {
+        valid = replay_write_ahead_log(db, bytes, have, &applied);
+        printf("Replayed %zu logged transactions from %s\n", applied, path);
+    } else if (have > 0) {
+        printf("%s is not a transaction log\n", path);
+        free(bytes);
+        close(fd);
+        return FAILURE;
+    }
+    free(bytes);
+
+    bool started = have >= WAL_MAGIC_SIZE;
+    if ((!started && (ftruncate(fd, 0) != 0 || pwrite(fd, WAL_MAGIC, WAL_MAGIC_SIZE, 0) != WAL_MAGIC_SIZE)) ||
+        (started && valid < have && ftruncate(fd, (off_t)valid) != 0) ||
+        lseek(fd, (off_t)valid, SEEK_SET) < 0 || fsync(fd) != 0) {
+        printf("Could not prepare the transaction log %s\n", path);
+        close(fd);
+        return FAILURE;
+    }
+
+    log->fd               = fd;
+    log->path             = strdup(path);
+    log->sync_bytes       = sync_bytes;
+    log->sync_interval_ms = sync_interval_ms;
+    log->unsynced_bytes   = 0;
+    log->buffered         = 0;
+    log->broken           = false;
+    clock_gettime(CLOCK_MONOTONIC, &log->last_sync);
+    return SUCCESS;
+}
+
+// Drop every entry of the log, after a snapshot made them unnecessary
+status_code truncate_write_ahead_log(Write_ahead_log *log) {
+    if (log->fd < 0) return SUCCESS;
+    if (sync_write_ahead_log(log) == FAILURE ||
+        ftruncate(log->fd, WAL_MAGIC_SIZE) != 0 ||
+        lseek(log->fd, WAL_MAGIC_SIZE, SEEK_SET) < 0 ||
+        fsync(log->fd) != 0) {
+        printf("Truncating the transaction log failed!\n");
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+// Drop the entries in front of offset and keep the ones after it. The kept entries
+// are copied to a new file that is renamed over the log, so a crash leaves either
+// the old log or the new one.
+status_code drop_write_ahead_log_before(Write_ahead_log *log, off_t offset) {
+    if (log->fd < 0 || offset <= WAL_MAGIC_SIZE) return SUCCESS;
+    if (sync_write_ahead_log(log) == FAILURE) return FAILURE;
+
+    off_t end = lseek(log->fd, 0, SEEK_END);
+    if (end < offset) {
+        printf("The transaction log is shorter than the saved offset, it was kept as it is\n");
+        return FAILURE; // the log was truncated since the offset was taken, it is not an entry boundary
+    }
+    size_t kept = end > offset ? (size_t)(end - offset) : 0;
+    uint8_t *bytes = (uint8_t*)malloc(kept + WAL_MAGIC_SIZE);
+    if (!bytes) {
+        printf("Memory allocation failed!\n");
+        return FAILURE;
+    }
+    memcpy(bytes, WAL_MAGIC, WAL_MAGIC_SIZE);
+    size_t have = 0;
+    while (have < kept) {
+        ssize_t got = pread(log->fd, bytes + WAL_MAGIC_SIZE + have, kept - have, offset + (off_t)have);
+        if (got <= 0) break;
+        have += (size_t)got;
+    }
+
+    char temporary_path[4096];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", log->path);
+    int fd = open(temporary_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    status_code done = fd >= 0 && have == kept ? SUCCESS : FAILURE;
+    if (done == SUCCESS) done = wal_write_all(fd, bytes, kept + WAL_MAGIC_SIZE);
+    if (done == SUCCESS && fsync(fd) != 0) done = FAILURE;
+    if (done == SUCCESS && rename(temporary_path, log->path) != 0) done = FAILURE;
+    free(bytes);
+    if (done == FAILURE) {
+        printf("Truncating the transaction log failed!\n");
+        if (fd >= 0) close(fd);
+        unlink(temporary_path);
+        return FAILURE;
+    }
+    close(log->fd);
+    log->fd = fd; // positioned at its end by the write above
+    return SUCCESS;
+}
+
+void close_write_ahead_log(Write_ahead_log *log) {
+    if (log->fd < 0) return;
+    sync_write_ahead_log(log);
+    close(log->fd);
+    log->fd = -1;
+    free(log->path);
+    log->path = NULL;
+}
+
+// Snapshot files: a header, the records as an array of fixed-size rows in time
+// order and an open addressing index from transaction ID to row. Opening one maps
+// it with MAP_PRIVATE and reads only the header, so startup does not depend on
+// the size of the history: pages of the file are read when they are first used,
+// and nothing is ever written back to it. Uniqueness checks probe the mapped
+// index directly, and displaying all records or a time range reads the rows from
+// the mapping, merged with the records. An update turns just its own row into a
+// record with materialize_snapshot_row. The statistics need every row in the
+// aggregates and call materialize_snapshot, which turns the remaining rows into
+// records. Neither validates the rows again, since only valid records are ever saved.
+// A new snapshot copies the rows that are not records yet straight from the mapping.
+//
+// The seller, buyer and pair totals are not stored: they are sums over the rows and
+// are rebuilt exactly when the rows become records. Stored totals would be counted a
+// second time by every row that later becomes a record.
+#define SNAPSHOT_MAGIC   "ETRSNAP1"
+#define SNAPSHOT_VERSION 1
+
+static status_code snapshot_write_all(int fd, const void *bytes, size_t length) {
+    return wal_write_all(fd, (const uint8_t*)bytes, length);
+}
+
+// Write every record of the Database and every row of the attached snapshot that is
+// not a record yet to path. Both are in time order and are merged, so the rows are
+// copied from the mapping without becoming records. The file is written next to path
+// and renamed over it once it is complete, so a crash never leaves half a snapshot.
+static status_code write_snapshot_file(Database *db, const char *path) {
+    const Time_index *index    = &db->time_index;
+    const Snapshot   *snapshot = &db->snapshot;
+    size_t row_count  = index->count + snapshot->row_count - snapshot->materialized_count;
+    size_t slot_count = 16;
+    while (slot_count < 2 * row_count) slot_count *= 2;
+
+    Snapshot_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version      = SNAPSHOT_VERSION;
+    header.row_size     = sizeof(Snapshot_row);
+    header.row_count    = row_count;
+    header.slot_count   = slot_count;
+    header.rows_offset  = sizeof(Snapshot_header);
+    header.slots_offset = header.rows_offset + row_count * sizeof(Snapshot_row);
+
+    Snapshot_row  *rows  = (Snapshot_row*)malloc((row_count ? row_count : 1) * sizeof(Snapshot_row));
+    Snapshot_slot *slots = (Snapshot_slot*)calloc(slot_count, sizeof(Snapshot_slot));
+    if (!rows || !slots) {
+        printf("Memory allocation failed!\n");
+        free(rows);
+        free(slots);
+        return FAILURE;
+    }
+    size_t entry = 0, mapped = 0;
+    for (size_t i = 0; i < row_count; i++) {
+        while (mapped < snapshot->row_count && is_snapshot_row_materialized(snapshot, mapped)) mapped++;
+        if (mapped < snapshot->row_count &&
+            (entry == index->count || snapshot->rows[mapped].packed_time < index->entries[entry].time_key)) {
+            rows[i] = snapshot->rows[mapped++];
+        } else {
+            const Record *record = index->entries[entry++].record;
+            rows[i].transaction_id = record->transaction_id;
+            rows[i].seller_id      = record->seller_id;
+            rows[i].buyer_id       = record->buyer_id;
+            rows[i].energy_amount  = record->energy_amount;
+            rows[i].price_per_unit = record->price_per_unit;
+            rows[i].packed_time    = record->packed_time;
+        }
+        size_t position = hash_key((uint64_t)rows[i].transaction_id) & (slot_count - 1);
+        while (slots[position].transaction_id != 0) {
+            position = (position + 1) & (slot_count - 1);
+        }
+        slots[position].transaction_id = rows[i].transaction_id;
+        slots[position].row            = (uint32_t)i;
+    }
+
+    char temporary_path[4096];
+    snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path);
+    int fd = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    status_code done = fd >= 0 ? SUCCESS : FAILURE;
+    if (done == SUCCESS) {
+        done = snapshot_write_all(fd, &header, sizeof(header));
+    }
+    if (done == SUCCESS) {
+        done = snapshot_write_all(fd, rows, row_count * sizeof(Snapshot_row));
+    }
+    if (done == SUCCESS) {
+        done = snapshot_write_all(fd, slots, slot_count * sizeof(Snapshot_slot));
+    }
+    if (done == SUCCESS && fsync(fd) != 0) done = FAILURE;
+    if (fd >= 0 && close(fd) != 0) done = FAILURE;
+    if (done == SUCCESS && rename(temporary_path, path) != 0) done = FAILURE;
+    free(rows);
+    free(slots);
+    if (done == FAILURE) {
+        fprintf(stderr, "Could not write the snapshot %s\n", path); // unbuffered, also from a forked child
+        unlink(temporary_path);
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+// A background save that is still running is collected first. Otherwise it would
+// later cut the truncated log at its old offset and could rename its older
+// snapshot over this one.
+status_code save_snapshot(Database *db, const char *path) {
+    finish_background_save(db, true);
+    if (write_snapshot_file(db, path) == FAILURE) {
+        return FAILURE;
+    }
+    // the snapshot holds everything the log did
+    db->background_save.log_offset = 0;
+    return truncate_write_ahead_log(&db->log);
+}
+
+// Write the snapshot from a forked child. The child sees the Database and the mapped
+// snapshot as they were at the fork, the kernel copies a page only when the parent
+// changes it, so the parent goes on inserting and updating while the child merges
+// and writes the rows. finish_background_save collects the child and drops the log
+// entries the snapshot holds.
+status_code save_snapshot_in_background(Database *db, const char *path) {
+    if (db->background_save.pid > 0) {
+        printf("A background save is already running\n");
+        return FAILURE;
+    }
+    if (sync_write_ahead_log(&db->log) == FAILURE) {
+        return FAILURE;
+    }
+    off_t log_offset = db->log.fd >= 0 ? lseek(db->log.fd, 0, SEEK_END) : 0;
+    fflush(stdout); // nothing buffered may be printed twice
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        printf("Could not start the background save\n");
+        return FAILURE;
+    }
+    if (pid == 0) {
+        _exit(write_snapshot_file(db, path) == SUCCESS ? 0 : 1);
+    }
+    db->background_save.pid        = pid;
+    db->background_save.log_offset = log_offset;
+    return SUCCESS;
+}
+
+// Collect a finished background save, waiting for it when wait is set
+void finish_background_save(Database *db, bool wait) {
+    Background_save *save = &db->background_save;
+    if (save->pid <= 0) return;
+
+    int status;
+    pid_t done = waitpid(save->pid, &status, wait ? 0 : WNOHANG);
+    if (done == 0) return; // still writing
+    if (done == save->pid && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        drop_write_ahead_log_before(&db->log, save->log_offset);
+        printf("Background save finished\n");
+    } else {
+        printf("Background save failed\n");
+    }
+    save->pid        = 0;
+    save->log_offset = 0;
+}
+
+// Map the snapshot at path into the Database, which must not hold records yet
+status_code open_snapshot(Database *db, const char *path) {
+    if (db->record_list || db->snapshot.map) {
+        printf("A snapshot can only be opened into an empty Database\n");
+        return FAILURE;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Could not open the snapshot %s\n", path);
+        return FAILURE;
+    }
+    struct stat status;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(Snapshot_header)) {
+        map = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd); // the mapping keeps the file
+    if (map == MAP_FAILED) {
+        printf("Could not map the snapshot %s\n", path);
+        return FAILURE;
+    }
+
+    const Snapshot_header *header = (const Snapshot_header*)map;
+    size_t size = (size_t)status.st_size;
+    // both counts are bounded by the file size before they are multiplied, so a
+    // damaged or crafted header cannot make the offsets wrap around
+    bool valid = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == SNAPSHOT_VERSION && header->row_size == sizeof(Snapshot_row) &&
+                 header->row_count <= size / sizeof(Snapshot_row) &&
+                 header->slot_count <= size / sizeof(Snapshot_slot) &&
+                 header->slot_count > 0 && (header->slot_count & (header->slot_count - 1)) == 0 &&
+                 header->row_count <= header->slot_count / 2 &&
+                 header->rows_offset == sizeof(Snapshot_header) &&
+                 header->slots_offset == header->rows_offset + header->row_count * sizeof(Snapshot_row) &&
+                 header->slots_offset <= size &&
+                 header->slot_count * sizeof(Snapshot_slot) == size - header->slots_offset;
+    if (!valid) {
+        printf("%s is not a snapshot of this version\n", path);
+        munmap(map, size);
+        return FAILURE;
+    }
+
+    uint8_t *materialized = (uint8_t*)calloc(header->row_count / 8 + 1, 1);
+    if (!materialized) {
+        printf("Memory allocation failed!\n");
+        munmap(map, size);
+        return FAILURE;
+    }
+
+    Snapshot *snapshot   = &db->snapshot;
+    snapshot->materialized       = materialized;
+    snapshot->materialized_count = 0;
+    snapshot->map        = map;
+    snapshot->map_size   = size;
+    snapshot->rows       = (const Snapshot_row*)((const char*)map + header->rows_offset);
+    snapshot->slots      = (const Snapshot_slot*)((const char*)map + header->slots_offset);
+    snapshot->row_count  = header->row_count;
+    snapshot->slot_count = header->slot_count;
+    return SUCCESS;
+}
+
+// Row of the attached snapshot with this transaction ID, row_count when there is none
+static size_t snapshot_row_of(const Snapshot *snapshot, int id) {
+    if (!snapshot->map || id == 0) return snapshot->row_count;
+    size_t mask = snapshot->slot_count - 1;
+    size_t position = hash_key((uint64_t)id) & mask;
+    while (snapshot->slots[position].transaction_id != 0) {
+        if (snapshot->slots[position].transaction_id == id) return snapshot->slots[position].row;
+        position = (position + 1) & mask;
+    }
+    return snapshot->row_count;
+}
+
+// True when a row of the attached snapshot has this transaction ID
+bool snapshot_contains(const Snapshot *snapshot, int id) {
+    return snapshot_row_of(snapshot, id) < snapshot->row_count;
+}
+
+// Turn the snapshot row with this transaction ID into a record, unless it is one
+// already or there is no such row. The other rows stay in the mapping.
+status_code materialize_snapshot_row(Database *db, int id) {
+    Snapshot *snapshot = &db->snapshot;
+    size_t    row      = snapshot_row_of(snapshot, id);
+    if (row >= snapshot->row_count || is_snapshot_row_materialized(snapshot, row)) return SUCCESS;
+
+    const Snapshot_row *saved = &snapshot->rows[row];
+    int log_fd = db->log.fd;
+    db->log.fd = -1; // the row is not new, it must not be logged again
+    status_code done = add_validated_record(db, saved->transaction_id, saved->seller_id, saved->buyer_id,
+                                            saved->energy_amount, saved->price_per_unit, saved->packed_time,
+                                            false, &db->record_list);
+    db->log.fd = log_fd;
+    if (done == FAILURE) {
+        printf("Loading transaction %d of the snapshot into memory failed!\n", id);
+        return FAILURE;
+    }
+    snapshot->materialized[row >> 3] |= (uint8_t)(1u << (row & 7));
+    snapshot->materialized_count++;
+    return SUCCESS;
+}
+
+// Turn every row of the attached snapshot that is not a record yet into one and
+// release the mapping. The rows are already in time order, so the time index only
+// needs one merge.
+status_code materialize_snapshot(Database *db) {
+    Snapshot *snapshot = &db->snapshot;
+    if (!snapshot->map) return SUCCESS;
+
+    int log_fd = db->log.fd;
+    db->log.fd = -1; // the rows are not new, they must not be logged again
+    size_t sorted = db->time_index.count;
+    status_code done = SUCCESS;
+    for (size_t i = 0; i < snapshot->row_count && done == SUCCESS; i++) {
+        if (is_snapshot_row_materialized(snapshot, i)) continue;
+        const Snapshot_row *row = &snapshot->rows[i];
+        done = add_validated_record(db, row->transaction_id, row->seller_id, row->buyer_id, row->energy_amount,
+                                    row->price_per_unit, row->packed_time, true, &db->record_list);
+    }
+    db->log.fd = log_fd;
+    if (time_index_sort_from(&db->time_index, sorted) == FAILURE) done = FAILURE;
+    if (done == FAILURE) {
+        printf("Loading the snapshot into memory failed!\n");
+    }
+    close_snapshot(snapshot);
+    return done;
+}
+
+void close_snapshot(Snapshot *snapshot) {
+    if (snapshot->map) {
+        munmap(snapshot->map, snapshot->map_size);
+    }
+    free(snapshot->materialized);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+// Transaction ID bitmap: the 900000 possible 6 digit IDs map directly to one bit
+// each, so a uniqueness check is a shift, a mask and one load no matter how many
+// transactions are stored. IDs outside MIN_INPUT_NO..MAX_INPUT_NO are never in use.
+bool transaction_id_bitmap_test(const Database *db, int id) {
+    unsigned int offset = (unsigned int)(id - MIN_INPUT_NO); // negative offsets wrap to huge values
+    if (offset > MAX_INPUT_NO - MIN_INPUT_NO) return false;
+    return (db->tid_bitmap[offset >> 6] >> (offset & 63)) & 1;
+}
+
+void transaction_id_bitmap_clear(Database *db, int id) {
+    unsigned int offset = (unsigned int)(id - MIN_INPUT_NO);
+    if (offset > MAX_INPUT_NO - MIN_INPUT_NO) return;
+    db->tid_bitmap[offset >> 6] &= ~((uint64_t)1 << (offset & 63));
+}
+
+// Mark the ID as used and report whether it already was
+bool transaction_id_bitmap_test_and_set(Database *db, int id) {
+    unsigned int offset = (unsigned int)(id - MIN_INPUT_NO);
+    if (offset > MAX_INPUT_NO - MIN_INPUT_NO) return false;
+    uint64_t *word = &db->tid_bitmap[offset >> 6];
+    uint64_t  bit  = (uint64_t)1 << (offset & 63);
+    bool      used = (*word & bit) != 0;
+    *word |= bit;
+    return used;
+}
+
+// Number of set bits of a word without any branch or table
+static int popcount64(uint64_t word) {
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((word * 0x0101010101010101ULL) >> 56);
+}
+
+size_t count_used_transaction_ids(const Database *db) {
+    size_t used = 0;
+    for (size_t i = 0; i < TID_BITMAP_WORDS; i++) {
+        used += popcount64(db->tid_bitmap[i]);
+    }
+    return used;
+}
+
+// Smallest ID >= from that is not in use, -1 when every ID from there on is taken.
+// Calling it again with the result + 1 iterates over all free IDs, a full word of
+// 64 used IDs is skipped with a single comparison.
+int next_free_transaction_id(const Database *db, int from) {
+    if (from < MIN_INPUT_NO) from = MIN_INPUT_NO;
+    if (from > MAX_INPUT_NO) return -1;
+
+    unsigned int offset = (unsigned int)(from - MIN_INPUT_NO);
+    size_t       word   = offset >> 6;
+    uint64_t     free_bits = ~db->tid_bitmap[word] & (~(uint64_t)0 << (offset & 63));
+    while (free_bits == 0) {
+        if (++word == TID_BITMAP_WORDS) return -1;
+        free_bits = ~db->tid_bitmap[word];
+    }
+    int bit = 0;
+    while (!((free_bits >> bit) & 1)) {
+        bit++;
+    }
+    int id = MIN_INPUT_NO + (int)(word * 64) + bit;
+    return id <= MAX_INPUT_NO ? id : -1; // bits past MAX_INPUT_NO in the last word are never free
+}
+
+// Smallest ID >= from that passes is_transaction_input_valid and is neither a
+// record nor a row of the snapshot, -1 when there is none. One ID in ten has the
+// right check digit, so this looks at about ten free IDs.
+int next_free_valid_transaction_id(const Database *db, int from) {
+    int id = next_free_transaction_id(db, from);
+    while (id != -1 && (!is_transaction_input_valid(id) || snapshot_contains(&db->snapshot, id))) {
+        id = next_free_transaction_id(db, id + 1);
+    }
+    return id;
+}
+
+// I have stored these as a part of meta data that will 
+// ensure the checking of the transaction ID , Seller ID, Buyer ID 
+
+///////////////////////////////
+Record *merge_sorted_lists(Record *left, Record *right, key sorting_key) {
+    if (!left) return right;
+    if (!right) return left;
+
+    Record *head = NULL, *tail = NULL;
+    if (compare_records(left, right, sorting_key) <= 0) {
+        head = left;
+        left = left->next_record;
+    } else {
+        head = right;
+        right = right->next_record;
+    }
+    tail = head;
+
+    while (left && right) {
+        if (compare_records(left, right, sorting_key) <= 0) {
+            tail->next_record = left;
+            left = left->next_record;
+        } else {
+            tail->next_record = right;
+            right = right->next_record;
+        }
+        tail = tail->next_record;
+    }
+    tail->next_record = (left) ? left : right;
+    return head;
+}
+
+Record *division(Record *head)
+{
+    Record *slow=head,*fast=head->next_record;
+    while(fast!=NULL && fast->next_record!=NULL)
+    {
+        slow=slow->next_record;
+        fast=fast->next_record->next_record;
+    }
+    return slow;
+}
+
+Record *sort_records(Record *head, key sorting_key) {
+    if (!head || !head->next_record) return head;
+
+    Record *mid = division(head);
+    Record *second_half = mid->next_record;
+    mid->next_record = NULL;
+
+    Record *left_sorted = sort_records(head, sorting_key);
+    Record *right_sorted = sort_records(second_half, sorting_key);
 
     return merge_sorted_lists(left_sorted, right_sorted, sorting_key);
 }
@@ -728,11 +2780,180 @@ Record* sort_records_wrapper(Database* Database_pointer, key sorting_key)
         return  head                                 ;
     }
     Record* head = Database_pointer->record_list;
-    head = sort_records(head, sorting_key);
+    if (count_natural_runs(head, sorting_key, NATURAL_MERGE_MAX_RUNS) <= NATURAL_MERGE_MAX_RUNS) {
+        head = natural_merge_sort_records(head, sorting_key); // already nearly in order
+    } else {
+        head = radix_sort_records(head, sorting_key);
+    }
     Database_pointer->sorted_based_on = sorting_key;
     return head; 
 }
 
+// Unsigned integer that orders records the same way as compare_records
+uint64_t record_sort_key(const Record *record, key sorting_key) {
+    switch (sorting_key) {
+        case MONTHS:
+            return (record->packed_time >> 16) & 15;
+        case SELLER_ID:
+            return (uint32_t)record->seller_id;
+        case BUYER_ID:
+            return (uint32_t)record->buyer_id;
+        case UNIQUE_PAIR_ID:
+            return record->unique_pair_id;
+        case TIME:
+            return record->packed_time;
+        case ENERGY: {
+            // the bits of a float order like the float itself once negative values are flipped
+            uint32_t bits;
+            memcpy(&bits, &record->energy_amount, sizeof(bits));
+            return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+        }
+        default:
+            return 0;
+    }
+}
+
+typedef struct Radix_item_tag
+{
+    uint64_t key    ;
+    Record*  record ;
+}Radix_item;
+//sort key of a record kept next to it so the passes never touch the Record nodes
+
+// Stable LSD radix sort of the record list on an integer key. The keys are taken
+// out of the records once, the histograms of every digit are counted in a single
+// pass and digits that are equal in every key are skipped, so a 20 bit seller ID
+// needs three passes and a month one. Falls back to the merge sort if there is
+// no memory for the two work arrays.
+Record* radix_sort_records(Record *head, key sorting_key) {
+    if (!head || !head->next_record) return head;
+
+    size_t count = 0;
+    for (Record *current = head; current; current = current->next_record) {
+        count++;
+    }
+    Radix_item *items = (Radix_item*)malloc(count * sizeof(Radix_item));
+    Radix_item *spare = (Radix_item*)malloc(count * sizeof(Radix_item));
+    if (!items || !spare) {
+        free(items);
+        free(spare);
+        return sort_records(head, sorting_key);
+    }
+
+    enum { DIGITS = 64 / RADIX_BITS, BUCKETS = 1 << RADIX_BITS };
+    size_t histogram[DIGITS][BUCKETS] = {{0}};
+
+    size_t i = 0;
+    for (Record *current = head; current; current = current->next_record, i++) {
+        uint64_t sort_key = record_sort_key(current, sorting_key);
+        items[i].key    = sort_key;
+        items[i].record = current;
+        for (int digit = 0; digit < DIGITS; digit++) {
+            histogram[digit][(sort_key >> (digit * RADIX_BITS)) & (BUCKETS - 1)]++;
+        }
+    }
+
+    for (int digit = 0; digit < DIGITS; digit++) {
+        size_t *counts = histogram[digit];
+        if (counts[(items[0].key >> (digit * RADIX_BITS)) & (BUCKETS - 1)] == count) {
+            continue; // every key has the same digit here, the pass would change nothing
+        }
+        size_t offset = 0;
+        for (int bucket = 0; bucket < BUCKETS; bucket++) {
+            size_t bucket_size = counts[bucket];
+            counts[bucket] = offset;
+            offset += bucket_size;
+        }
+        for (i = 0; i < count; i++) {
+            spare[counts[(items[i].key >> (digit * RADIX_BITS)) & (BUCKETS - 1)]++] = items[i];
+        }
+        Radix_item *temp = items;
+        items = spare;
+        spare = temp;
+    }
+
+    for (i = 0; i + 1 < count; i++) {
+        items[i].record->next_record = items[i + 1].record;
+    }
+    items[count - 1].record->next_record = NULL;
+    head = items[0].record;
+
+    free(items);
+    free(spare);
+    return head;
+}
+
+// Cuts the first run off the list and returns it, *rest is set to the records
+// after it. Non-decreasing runs are kept as they are, strictly decreasing runs
+// are reversed while they are cut off, which keeps the sort stable.
+static Record* cut_natural_run(Record *head, Record **rest, key sorting_key) {
+    Record *run  = head;
+    Record *tail = head;
+    head = head->next_record;
+    if (head && compare_records(tail, head, sorting_key) > 0) {
+        run->next_record = NULL;
+        while (head && compare_records(tail, head, sorting_key) > 0) {
+            Record *next = head->next_record;
+            tail = head;
+            head->next_record = run;
+            run = head;
+            head = next;
+        }
+    } else {
+        while (head && compare_records(tail, head, sorting_key) <= 0) {
+            tail = head;
+            head = head->next_record;
+        }
+        tail->next_record = NULL;
+    }
+    *rest = head;
+    return run;
+}
+
+// Number of natural runs in the list, counting stops once it passes limit
+size_t count_natural_runs(Record *head, key sorting_key, size_t limit) {
+    if (!head) return 0;
+    size_t runs = 1;
+    int direction = 0; // 1 while ascending, -1 while strictly descending, 0 at the start of a run
+    for (Record *current = head; current->next_record && runs <= limit; current = current->next_record) {
+        int order = compare_records(current, current->next_record, sorting_key);
+        if (direction == 0) {
+            direction = order > 0 ? -1 : 1;
+        } else if ((direction == 1 && order > 0) || (direction == -1 && order <= 0)) {
+            runs++;
+            direction = 0;
+        }
+    }
+    return runs;
+}
+
+// Merge sort that starts from the runs already present in the list. Runs are
+// merged as they are found, like the carries of a binary counter: slot k holds
+// the merge of 2^k runs, so every merge works on records that were just visited.
+// A list that is already in order, in either direction, costs one pass.
+Record* natural_merge_sort_records(Record *head, key sorting_key) {
+    if (!head || !head->next_record) return head;
+
+    Record *slots[64] = {NULL}; // 2^64 runs are never reached
+    while (head) {
+        Record *run = cut_natural_run(head, &head, sorting_key);
+        int slot = 0;
+        while (slots[slot]) {
+            run = merge_sorted_lists(slots[slot], run, sorting_key); // older run first keeps it stable
+            slots[slot++] = NULL;
+        }
+        slots[slot] = run;
+    }
+
+    Record *sorted = NULL;
+    for (int slot = 0; slot < 64; slot++) {
+        if (slots[slot]) {
+            sorted = merge_sorted_lists(slots[slot], sorted, sorting_key);
+        }
+    }
+    return sorted;
+}
+
 // Division function for seller list
 Seller* divide_seller_list(Seller* head) {
     if (!head || !head->next_seller) return NULL;
@@ -908,20 +3129,39 @@ void sort_pairs_list_based_on_number_of_transactions(Database* db) {
 
 void initialise_database(Database* database_of_structures)
 {
-    database_of_structures= (Database*)malloc(sizeof(Database));
     if(database_of_structures)
     {
     // INITIALLY WHEN THE DATABASE STARTED
+    // the Database is owned by the caller, only its fields are initialised here
     database_of_structures->record_list             = NULL     ;
     database_of_structures->seller_list             = NULL     ;
     database_of_structures->buyer_list              = NULL     ;
     database_of_structures->pairs_list              = NULL     ;
     database_of_structures->sorted_based_on         = NULL_KEY ;
+    initialise_slab(&database_of_structures->record_slab   , sizeof(Record))               ;
+    initialise_slab(&database_of_structures->seller_slab   , sizeof(Seller))               ;
+    initialise_slab(&database_of_structures->buyer_slab    , sizeof(Buyer))                ;
+    initialise_slab(&database_of_structures->pair_slab     , sizeof(Pair))                 ;
+    database_of_structures->unique_check            = BITMAP_LOOKUP;
+    memset(database_of_structures->tid_bitmap, 0, sizeof(database_of_structures->tid_bitmap));
+    initialise_time_index(&database_of_structures->time_index);
+    initialise_energy_index(&database_of_structures->energy_index);
+    initialise_write_ahead_log(&database_of_structures->log);
+    memset(&database_of_structures->snapshot, 0, sizeof(database_of_structures->snapshot));
+    database_of_structures->background_save.pid        = 0;
+    database_of_structures->background_save.log_offset = 0;
+    initialise_hash_index(&database_of_structures->seller_index);
+    initialise_hash_index(&database_of_structures->buyer_index);
+    initialise_hash_index(&database_of_structures->pair_index);
+    database_of_structures->live_rankings = false;
+    for (int order = 0; order < RANKING_COUNT; order++) {
+        initialise_top_k(&database_of_structures->rankings[order], 0);
+    }
     initialise_the_hashtable(database_of_structures)          ;
     }
     else
     {
-        printf("DATABASE INITIALISATION FAILED DUE TO NO FREE MEMORY :(");
+        printf("DATABASE INITIALISATION FAILED DUE TO NO DATABASE :(");
     }
     //IF WE ALREADY HAVE THE FILE WHICH CONTAINS THE DATABASE
     //FROM THE PREVIOUS RUN PROGRAM INPUTS
@@ -949,11 +3189,22 @@ status_code insert_record_into_record_list(Database *db,int TID,int SID,int BID,
     bool valid_input= validity_checker(db,TID,SID,BID,EA,PPU,samay);
     if(valid_input)
     {
+        SC = add_validated_record(db, TID, SID, BID, EA, PPU, pack_time_stamp(*samay), false, lpptr);
+    }
+    return SC;
+}
+
+// Add a transaction that already passed validity_checker to the record list and every
+// index. With defer_time_order the record is only appended to the time index, the
+// caller must restore its order with time_index_sort_from before it is queried.
+status_code add_validated_record(Database *db, int TID, int SID, int BID, float EA, float PPU,
+                                 uint32_t time_key, bool defer_time_order, Record** lpptr)
+{
         Record* nptr                        ;
         Record* list_pointer                ;
-        SC                   =  SUCCESS     ;
+        status_code SC       =  SUCCESS     ;
         list_pointer         =  *lpptr      ;
-        nptr=(Record*)malloc(sizeof(Record));
+        nptr=(Record*)slab_alloc(&db->record_slab);
         
     
         if(nptr==NULL)
@@ -967,143 +3218,234 @@ status_code insert_record_into_record_list(Database *db,int TID,int SID,int BID,
          nptr->seller_id        = SID                  ;
          nptr->energy_amount    = EA                   ;
          nptr->price_per_unit   = PPU                  ;
-         nptr->time.date        = samay->date          ;
-         nptr->time.month       = samay->month         ;
-         nptr->time.year        = samay->year          ;
-         nptr->time.hours       = samay->hours         ;        
-         nptr->time.minutes     = samay->minutes       ;
+         nptr->packed_time      = time_key             ;
          nptr->transaction_money= PPU*EA               ;
-         nptr->transaction_hash = hashing_function(TID);
-         nptr->unique_pair_id   = SID * MIN_INPUT_NO + BID   ;
-
-
+         nptr->unique_pair_id   = pair_key(SID, BID)         ;
+
+         // the seller, buyer and pair nodes are created first, their totals change only once the insert succeeded
+         if(!find_or_add_seller(db, SID) || !find_or_add_buyer(db, BID) || !find_or_add_pair(db, SID, BID))
+         {
+             slab_free(&db->record_slab, nptr);
+             return FAILURE;
+         }
+         status_code indexed = defer_time_order ? time_index_append(&db->time_index, time_key, nptr)
+                                                : time_index_insert(&db->time_index, time_key, nptr);
+         if(indexed == FAILURE)
+         {
+             slab_free(&db->record_slab, nptr);
+             return FAILURE;
+         }
+         if(energy_index_insert(&db->energy_index, nptr) == FAILURE)
+         {
+             time_index_remove(&db->time_index, time_key, nptr);
+             slab_free(&db->record_slab, nptr);
+             return FAILURE;
+         }
+         if(storing_the_transactionID_along_with_hash(db,TID,nptr) == FAILURE)
+         {
+             energy_index_remove(&db->energy_index, EA, nptr);
+             time_index_remove(&db->time_index, time_key, nptr);
+             slab_free(&db->record_slab, nptr);
+             return FAILURE;
+         }
+         // logged after every step that can fail, so the log only holds inserts that
+         // happened, and a failed log write undoes the index changes
+         if(log_inserted_record(&db->log, nptr) == FAILURE)
+         {
+             hash_index_remove(&db->tid_index, (unsigned long)TID);
+             energy_index_remove(&db->energy_index, EA, nptr);
+             time_index_remove(&db->time_index, time_key, nptr);
+             slab_free(&db->record_slab, nptr);
+             return FAILURE;
+         }
+         transaction_id_bitmap_test_and_set(db, TID);
 
          nptr->next_record      = list_pointer  ;
          list_pointer           = nptr          ;
          *lpptr                 = list_pointer  ;
 
-         
-         storing_the_transactionID_along_with_hash(db,TID);
+         apply_record_to_aggregates(db, nptr, 1, EA, nptr->transaction_money);
          db->sorted_based_on = NULL_KEY                   ;
         }
-    }
     return SC;
 }
 
 
+// Seller, buyer and pair aggregates: every seller, buyer and (seller, buyer) pair
+// has one node that is found through seller_index / buyer_index / pair_index in
+// O(1), and the insert and update paths add their change to those nodes, so the
+// statistics are always current and never have to be recomputed from the records.
+
+Seller* get_seller(Database *db, int SID) {
+    Hash_slot *slot = hash_index_find(&db->seller_index, (unsigned long)SID);
+    return slot ? (Seller*)slot->node : NULL;
+}
+
+Buyer* get_buyer(Database *db, int BID) {
+    Hash_slot *slot = hash_index_find(&db->buyer_index, (unsigned long)BID);
+    return slot ? (Buyer*)slot->node : NULL;
+}
+
+// Node of the seller, a new seller with no revenue is added when there is none yet
+Seller* find_or_add_seller(Database *db, int SID) {
+    Seller *seller = get_seller(db, SID);
+    if (seller) return seller;
+
+    seller = (Seller *)slab_alloc(&db->seller_slab);
+    if (!seller) return NULL;
+    seller->SID = SID;
+    seller->Revenue = 0.0;
+    seller->price_below_300_units = 0.0; // Initialized to some default value(say zero)
+    seller->price_above_300_units = 0.0; // Initialized to some default value(say zero)
+    seller->regular_buyer_list = NULL;
+    if (hash_index_insert(&db->seller_index, (unsigned long)SID, seller) == FAILURE) {
+        slab_free(&db->seller_slab, seller);
+        return NULL;
+    }
+    seller->next_seller = db->seller_list;
+    db->seller_list = seller;
+    return seller;
+}
+
+Buyer* find_or_add_buyer(Database *db, int BID) {
+    Buyer *buyer = get_buyer(db, BID);
+    if (buyer) return buyer;
+
+    buyer = (Buyer *)slab_alloc(&db->buyer_slab);
+    if (!buyer) return NULL;
+    buyer->BID = BID;
+    buyer->Energy = 0.0;
+    if (hash_index_insert(&db->buyer_index, (unsigned long)BID, buyer) == FAILURE) {
+        slab_free(&db->buyer_slab, buyer);
+        return NULL;
+    }
+    buyer->next_buyer = db->buyer_list;
+    db->buyer_list = buyer;
+    return buyer;
+}
+
+Pair* get_pair(Database *db, int SID, int BID) {
+    Hash_slot *slot = hash_index_find(&db->pair_index, pair_key(SID, BID));
+    return slot ? (Pair*)slot->node : NULL;
+}
+
+Pair* find_or_add_pair(Database *db, int SID, int BID) {
+    Pair *pair = get_pair(db, SID, BID);
+    if (pair) return pair;
+
+    pair = (Pair*)slab_alloc(&db->pair_slab);
+    if (!pair) return NULL;
+    pair->upid    = pair_key(SID, BID);
+    pair->SID     = SID;
+    pair->BID     = BID;
+    pair->NOT     = 0;
+    pair->revenue = 0.0;
+    if (hash_index_insert(&db->pair_index, pair->upid, pair) == FAILURE) {
+        slab_free(&db->pair_slab, pair);
+        return NULL;
+    }
+    pair->next_unique_pair = db->pairs_list;
+    db->pairs_list = pair;
+    return pair;
+}
+
+// Add the buyer to the regular buyers of the seller unless it is already there
+static status_code add_regular_buyer(Database *db, Seller *seller, int BID) {
+    Buyer *buyer = seller->regular_buyer_list;
+    Buyer *prev = NULL;
+    while (buyer && buyer->BID != BID) {
+        prev = buyer;
+        buyer = buyer->next_buyer;
+    }
+    if (buyer) return SUCCESS;
+
+    Buyer *new_buyer = (Buyer *)slab_alloc(&db->buyer_slab);
+    if (!new_buyer) return FAILURE;
+    new_buyer->BID = BID;
+    new_buyer->Energy = 0;  // We can update this later if needed
+    new_buyer->next_buyer = NULL;
+    if (prev) {
+        prev->next_buyer = new_buyer;
+    } else {
+        seller->regular_buyer_list = new_buyer;
+    }
+    return SUCCESS;
+}
+
+// Add the change of one record to the aggregates of its seller, buyer and pair:
+// an inserted record passes one transaction and its own energy and money, an
+// updated record passes no transaction and the difference between its new and
+// old values. The seller, buyer and pair must exist.
+void apply_record_to_aggregates(Database *db, Record *record, int transaction_delta,
+                                float energy_delta, float money_delta) {
+    Seller *seller = get_seller(db, record->seller_id);
+    Buyer  *buyer  = get_buyer(db, record->buyer_id);
+    Pair   *pair   = get_pair(db, record->seller_id, record->buyer_id);
+
+    pair->NOT     += transaction_delta;
+    pair->revenue += money_delta;
+    if (transaction_delta && pair->NOT == FREQUENT_BUYING_THRESHOLD) {
+        add_regular_buyer(db, seller, pair->BID);
+    }
+
+    seller->Revenue += money_delta;
+    if (db->live_rankings) {
+        top_k_track(&db->rankings[PAIRS_BY_TRANSACTIONS], pair->NOT, pair);
+        top_k_track(&db->rankings[PAIRS_BY_REVENUE], pair->revenue, pair);
+        top_k_track(&db->rankings[SELLERS_BY_REVENUE], seller->Revenue, seller);
+    }
+    // The seller shows the price of its most recently inserted or updated transaction
+    // in each band. The walk this replaced kept the record last in list order.
+    if (record->energy_amount <= 300) {
+        seller->price_below_300_units = record->price_per_unit;
+    } else {
+        seller->price_above_300_units = record->price_per_unit;
+    }
+    buyer->Energy += energy_delta;
+}
+
+// Recompute the energy of every buyer from the records. The insert and update
+// paths keep the buyers current, this is only needed to rebuild them.
 void populate_buyer_list(Database *db)
 {
-    if (!db->record_list) return;
-    
-    Record *current = db->record_list;
-    while (current)
-    {
-        Buyer *bptr = db->buyer_list;
-        Buyer *prev = NULL;
-        while (bptr && bptr->BID != current->buyer_id)
-        {
-            prev = bptr;
-            bptr = bptr->next_buyer;
-        }
-        if (!bptr)
-        {
-            Buyer *new_buyer = (Buyer *)malloc(sizeof(Buyer));
-            new_buyer->BID = current->buyer_id;
-            new_buyer->Energy = current->energy_amount;
-            new_buyer->next_buyer = NULL;
-            
-            if (prev)
-                prev->next_buyer = new_buyer;
-            else
-                db->buyer_list = new_buyer;
-        }
-        else
-        {
-            bptr->Energy += current->energy_amount;
-        }
-        current = current->next_record;
+    for (Buyer *buyer = db->buyer_list; buyer; buyer = buyer->next_buyer) {
+        buyer->Energy = 0.0;
+    }
+    for (Record *current = db->record_list; current; current = current->next_record) {
+        Buyer *buyer = find_or_add_buyer(db, current->buyer_id);
+        if (!buyer) return;
+        buyer->Energy += current->energy_amount;
     }
 }
  
-
+// Recompute the revenue of every seller from the records, see populate_buyer_list
 void populate_seller_list(Database *db)
 {
-    if (!db->record_list) return;
-    
-    Record *current = db->record_list;
-    while (current)
-    {
-        Seller *sptr = db->seller_list;
-        Seller *prev = NULL;
-        while (sptr && sptr->SID != current->seller_id)
-        {
-            prev = sptr;
-            sptr = sptr->next_seller;
-        }
-        if (!sptr)
-        {
-            Seller *new_seller = (Seller *)malloc(sizeof(Seller));
-            new_seller->SID = current->seller_id;
-            new_seller->Revenue = current->transaction_money;
-            new_seller->price_below_300_units = 0.0; // Initialized to some default value(say zero)
-            new_seller->price_above_300_units = 0.0; // Initialized to some default value(say zero)
-            new_seller->next_seller = NULL;
-            new_seller->regular_buyer_list = NULL;
-            
-            if (prev)
-                prev->next_seller = new_seller;
-            else
-                db->seller_list = new_seller;
-        }
-        else
-        {
-            sptr->Revenue += current->transaction_money;
-        }
-        current = current->next_record;
+    for (Seller *seller = db->seller_list; seller; seller = seller->next_seller) {
+        seller->Revenue = 0.0;
+    }
+    for (Record *current = db->record_list; current; current = current->next_record) {
+        Seller *seller = find_or_add_seller(db, current->seller_id);
+        if (!seller) return;
+        seller->Revenue += current->transaction_money;
     }
 }
 
 
+// Recompute the transaction count and revenue of every pair from the records,
+// see populate_buyer_list
 void populate_pairs_list(Database* db) {
     if (!db) return;
 
-    Record* current = db->record_list;
-    while (current) {
-        unsigned long upid = current->unique_pair_id;
-        Pair* pair = db->pairs_list;
-        Pair* prev = NULL;
-
-        // Search for existing pair
-        while (pair && pair->upid != upid) {
-            prev = pair;
-            pair = pair->next_unique_pair;
-        }
-
-        if (!pair) {
-            // Create a new pair if not found
-            Pair* new_pair = (Pair*)malloc(sizeof(Pair));
-            if (!new_pair) return;
-
-            new_pair->upid = upid;
-            new_pair->SID = current->seller_id;
-            new_pair->BID = current->buyer_id;
-            new_pair->NOT = 1;  // Number of transactions
-            new_pair->revenue = current->transaction_money;
-            new_pair->next_unique_pair = NULL;
-
-            // Insert into the pairs list
-            if (prev) {
-                prev->next_unique_pair = new_pair;
-            } else {
-                db->pairs_list = new_pair;
-            }
-        } else {
-            // Update existing pair
-            pair->NOT++;
-            pair->revenue += current->transaction_money;
-        }
-
-        current = current->next_record;
+    for (Pair *pair = db->pairs_list; pair; pair = pair->next_unique_pair) {
+        pair->NOT = 0;
+        pair->revenue = 0.0;
+    }
+    for (Record *current = db->record_list; current; current = current->next_record) {
+        Pair *pair = find_or_add_pair(db, current->seller_id, current->buyer_id);
+        if (!pair) return;
+        pair->NOT++;
+        pair->revenue += current->transaction_money;
     }
 }
 
@@ -1113,7 +3455,6 @@ Pair* find_pair_that_has_maximum_transactions(Database* db) {
     if (!db || !db->record_list) {
         return NULL;
     }
-    populate_pairs_list(db);
     // Find pair with maximum transactions
     Pair* current_pair = db->pairs_list;
     Pair* max_pair = NULL;
@@ -1131,6 +3472,185 @@ Pair* find_pair_that_has_maximum_transactions(Database* db) {
 }
 
 
+// Top-K rankings: a min-heap of k entries keeps the best k nodes seen so far,
+// a node only enters when it beats the root, so ranking n nodes costs O(n log k)
+// instead of sorting all of them.
+
+status_code initialise_top_k(Top_k *top, size_t k) {
+    top->heap  = NULL;
+    top->k     = k;
+    top->count = 0;
+    top->stale = false;
+    if (k == 0) return SUCCESS;
+    top->heap = (Top_k_entry*)malloc(k * sizeof(Top_k_entry));
+    if (!top->heap) {
+        printf("Memory allocation failed!\n");
+        top->k = 0;
+        return FAILURE;
+    }
+    return SUCCESS;
+}
+
+static void top_k_swap(Top_k *top, size_t i, size_t j) {
+    Top_k_entry entry = top->heap[i];
+    top->heap[i] = top->heap[j];
+    top->heap[j] = entry;
+}
+
+static void top_k_sift_up(Top_k *top, size_t i) {
+    while (i > 0 && top->heap[i].score < top->heap[(i - 1) / 2].score) {
+        top_k_swap(top, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void top_k_sift_down(Top_k *top, size_t i) {
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1, right = 2 * i + 2;
+        if (left < top->count && top->heap[left].score < top->heap[smallest].score) smallest = left;
+        if (right < top->count && top->heap[right].score < top->heap[smallest].score) smallest = right;
+        if (smallest == i) return;
+        top_k_swap(top, i, smallest);
+        i = smallest;
+    }
+}
+
+// Offer a node that is not in the heap yet
+void top_k_offer(Top_k *top, double score, void *node) {
+    if (top->count < top->k) {
+        top->heap[top->count].score = score;
+        top->heap[top->count].node  = node;
+        top_k_sift_up(top, top->count++);
+    } else if (top->k > 0 && score > top->heap[0].score) {
+        top->heap[0].score = score;
+        top->heap[0].node  = node;
+        top_k_sift_down(top, 0);
+    }
+}
+
+// Report the new score of a node that may already be in the heap. Looking the node
+// up is a scan of k entries, which is cheap for the small k rankings are used with.
+void top_k_track(Top_k *top, double score, void *node) {
+    for (size_t i = 0; i < top->count; i++) {
+        if (top->heap[i].node == node) {
+            double old_score = top->heap[i].score;
+            top->heap[i].score = score;
+            if (score >= old_score) {
+                top_k_sift_down(top, i);
+            } else {
+                top->stale = true; // the heap can no longer tell if a node outside is better
+                top_k_sift_up(top, i);
+            }
+            return;
+        }
+    }
+    top_k_offer(top, score, node);
+}
+
+void free_top_k(Top_k *top) {
+    free(top->heap);
+    top->heap  = NULL;
+    top->k     = 0;
+    top->count = 0;
+    top->stale = false;
+}
+
+double ranking_score(ranking order, const void *node) {
+    switch (order) {
+        case PAIRS_BY_TRANSACTIONS: return ((const Pair*)node)->NOT;
+        case PAIRS_BY_REVENUE:      return ((const Pair*)node)->revenue;
+        case SELLERS_BY_REVENUE:    return ((const Seller*)node)->Revenue;
+        default:                    return 0.0;
+    }
+}
+
+// Offer every pair or seller of the database to the heap
+static void top_k_offer_all(Database *db, ranking order, Top_k *top) {
+    if (order == SELLERS_BY_REVENUE) {
+        for (Seller *seller = db->seller_list; seller; seller = seller->next_seller) {
+            top_k_offer(top, seller->Revenue, seller);
+        }
+    } else {
+        for (Pair *pair = db->pairs_list; pair; pair = pair->next_unique_pair) {
+            top_k_offer(top, ranking_score(order, pair), pair);
+        }
+    }
+}
+
+static int compare_top_k_entries(const void *a, const void *b) {
+    double first = ((const Top_k_entry*)a)->score, second = ((const Top_k_entry*)b)->score;
+    return (first < second) - (first > second); // best score first
+}
+
+// Write the k best pairs or sellers to out, best first, and return how many were written.
+// The live ranking answers without touching the aggregates when it holds at least k nodes.
+size_t top_k(Database *db, ranking order, size_t k, void **out) {
+    if (!db || k == 0) return 0;
+
+    Top_k *live = &db->rankings[order];
+    Top_k  top;
+    bool   own_heap = !(db->live_rankings && k <= live->k);
+    if (own_heap) {
+        if (initialise_top_k(&top, k) == FAILURE) return 0;
+        top_k_offer_all(db, order, &top);
+    } else {
+        if (live->stale) {
+            live->count = 0;
+            live->stale = false;
+            top_k_offer_all(db, order, live);
+        }
+        if (initialise_top_k(&top, live->count) == FAILURE) return 0;
+        memcpy(top.heap, live->heap, live->count * sizeof(Top_k_entry));
+        top.count = live->count;
+    }
+
+    qsort(top.heap, top.count, sizeof(Top_k_entry), compare_top_k_entries);
+    size_t written = top.count < k ? top.count : k;
+    for (size_t i = 0; i < written; i++) {
+        out[i] = top.heap[i].node;
+    }
+    free_top_k(&top);
+    return written;
+}
+
+// Keep the k best pairs and sellers of every ranking up to date on each insert and update
+status_code enable_live_rankings(Database *db, size_t k) {
+    for (int order = 0; order < RANKING_COUNT; order++) {
+        free_top_k(&db->rankings[order]);
+        if (initialise_top_k(&db->rankings[order], k) == FAILURE) {
+            return FAILURE;
+        }
+        top_k_offer_all(db, (ranking)order, &db->rankings[order]);
+    }
+    db->live_rankings = true;
+    return SUCCESS;
+}
+
+void display_top_k(Database *db, ranking order, size_t k) {
+    void **nodes = (void**)malloc((k ? k : 1) * sizeof(void*));
+    if (!nodes) {
+        printf("Memory allocation failed!\n");
+        return;
+    }
+    size_t found = top_k(db, order, k, nodes);
+    if (found == 0) {
+        printf("No entries to display.\n");
+    }
+    for (size_t i = 0; i < found; i++) {
+        if (order == SELLERS_BY_REVENUE) {
+            Seller *seller = (Seller*)nodes[i];
+            printf("%zu. Seller ID: %d, Revenue: %.2f\n", i + 1, seller->SID, seller->Revenue);
+        } else {
+            Pair *pair = (Pair*)nodes[i];
+            printf("%zu. Seller ID: %d, Buyer ID: %d, Number of Transactions: %d, Total Revenue: %.2f\n",
+                   i + 1, pair->SID, pair->BID, pair->NOT, pair->revenue);
+        }
+    }
+    free(nodes);
+}
+
+
 // Function to calculate revenue of a seller
 float revenue_of_seller(Database* db, int sid) {
     if (!db || !db->record_list) {
@@ -1158,61 +3678,6 @@ float revenue_of_seller(Database* db, int sid) {
 }
 
 
-// Function to fill pairs list based on transactions
-void filling_pairs(Database* db) {
-    if (!db || !db->record_list) {
-        printf("No records available to create pairs.\n");
-        return;
-    }
-    // First, sort records based on unique pair ID
-    db->record_list = sort_records_wrapper(db, UNIQUE_PAIR_ID);
-    // Clear existing pairs list
-    while (db->pairs_list) {
-        Pair* temp = db->pairs_list;
-        db->pairs_list = db->pairs_list->next_unique_pair;
-        free(temp);
-    }
-    db->pairs_list = NULL;
-
-    Record* current = db->record_list;
-    Pair* current_pair = NULL;
-    unsigned long current_unique_pair_id = -1;
-
-    while (current) {
-        if (current->unique_pair_id != current_unique_pair_id) {
-            // Create new pair
-            Pair* new_pair = (Pair*)malloc(sizeof(Pair));
-            if (!new_pair) {
-                printf("Memory allocation failed for new pair!\n");
-                return;
-            }
-
-            new_pair->BID = current->buyer_id;
-            new_pair->SID = current->seller_id;
-            new_pair->upid = current->unique_pair_id;
-            new_pair->revenue = current->transaction_money;
-            new_pair->NOT = 1;
-            new_pair->next_unique_pair = NULL;
-
-            // Add to pairs list
-            if (!db->pairs_list) {
-                db->pairs_list = new_pair;
-            } else {
-                current_pair->next_unique_pair = new_pair;
-            }
-            current_pair = new_pair;
-            current_unique_pair_id = current->unique_pair_id;
-        } else {
-            // Update existing pair
-            current_pair->NOT++;
-            current_pair->revenue += current->transaction_money;
-        }
-        
-        current = current->next_record;
-    }
-}
-
-
 status_code update_existing_transaction(Database* db, int TID, float EA, float PPU, time_stamp samay)
 {
     if (!db) {
@@ -1221,10 +3686,14 @@ status_code update_existing_transaction(Database* db, int TID, float EA, float P
     }
 
     status_code done = FAILURE;
-    Record* head = db->record_list;
     
     bool valid = is_transaction_input_valid(TID) && is_priceperunit_input_valid(PPU) && is_energy_input_valid(EA);
-    bool already_present = !(is_transaction_id_input_unique(db, TID)) && is_time_input_valid(samay);
+    if (materialize_snapshot_row(db, TID) == FAILURE) { // the transaction may still be a row of the snapshot
+        return FAILURE;
+    }
+    Record* head = db->record_list;
+    Record* node_pointer = get_transaction(db, TID); // direct handle from the transaction ID index
+    bool already_present = node_pointer && is_time_input_valid(samay);
 
     if (!head) {
         printf("The database is Empty. Cannot update transaction.\n");
@@ -1236,24 +3705,35 @@ status_code update_existing_transaction(Database* db, int TID, float EA, float P
         printf("Any transaction with the TransactionID: %d does not exist in our Database.\n", TID);
     }
     else if (valid && already_present) {
-        Record* node_pointer = head;
-        while (node_pointer && node_pointer->transaction_id != TID) {
-            node_pointer = node_pointer->next_record;
-        }
-        
-        if (!node_pointer) {
-            printf("Transaction ID: %d not found.\n", TID);
+        uint32_t old_time_key = node_pointer->packed_time;
+        uint32_t new_time_key = pack_time_stamp(samay);
+        Record   updated      = *node_pointer;
+        updated.energy_amount  = EA;
+        updated.price_per_unit = PPU;
+        updated.packed_time    = new_time_key;
+        // logged before the record changes, so a failed log write leaves it as it was
+        if (log_updated_record(&db->log, &updated) == FAILURE) {
             return FAILURE;
         }
-
+        if (old_time_key != new_time_key) {
+            // removing first leaves room, so the insert cannot fail to grow the index
+            time_index_remove(&db->time_index, old_time_key, node_pointer);
+            time_index_insert(&db->time_index, new_time_key, node_pointer);
+        }
+        float old_energy_amount     = node_pointer->energy_amount;
+        float old_transaction_money = node_pointer->transaction_money;
+        if (old_energy_amount != EA) {
+            // removing first frees a node, so the insert cannot fail to allocate one
+            energy_index_remove(&db->energy_index, old_energy_amount, node_pointer);
+            node_pointer->energy_amount = EA;
+            energy_index_insert(&db->energy_index, node_pointer);
+        }
         node_pointer->energy_amount = EA;
         node_pointer->price_per_unit = PPU;
-        node_pointer->time.date = samay.date;
-        node_pointer->time.month = samay.month;
-        node_pointer->time.year = samay.year;
-        node_pointer->time.hours = samay.hours;
-        node_pointer->time.minutes = samay.minutes;
+        node_pointer->packed_time = new_time_key;
         node_pointer->transaction_money = PPU * EA ;
+        apply_record_to_aggregates(db, node_pointer, 0, EA - old_energy_amount,
+                                   node_pointer->transaction_money - old_transaction_money);
         db->sorted_based_on = NULL_KEY ;
         done = SUCCESS;
     }
@@ -1261,145 +3741,627 @@ status_code update_existing_transaction(Database* db, int TID, float EA, float P
     return done;
 }
 
-void fill_the_regular_buyers_list_in_seller_nodes(Database *db) {
-    if (!db || !db->pairs_list) return;
+///////////////////////////
+
+void clear(Database *db) {
+    if (!db) return;
 
-    Pair *current_pair = db->pairs_list;
-    
-    while (current_pair) {
-        if (current_pair->NOT >= FREQUENT_BUYING_THRESHOLD) {
-            // Find the seller in the seller list
-            Seller *seller = db->seller_list;
-            while (seller && seller->SID != current_pair->SID) {
-                seller = seller->next_seller;
-            }
+    finish_background_save(db, true);
+    close_write_ahead_log(&db->log); // the last group of log entries reaches the disk first
+    close_snapshot(&db->snapshot);
 
-            if (seller) {
-                // Check if the buyer is already in the regular buyer list
-                Buyer *buyer = seller->regular_buyer_list;
-                Buyer *prev = NULL;
-                while (buyer && buyer->BID != current_pair->BID) {
-                    prev = buyer;
-                    buyer = buyer->next_buyer;
-                }
+    // Every node of every list lives in one of the slabs, so the lists do not
+    // have to be walked: releasing the slabs frees all of them chunk by chunk
+    slab_release(&db->record_slab)   ;
+    slab_release(&db->seller_slab)   ;
+    slab_release(&db->buyer_slab)    ;
+    slab_release(&db->pair_slab)     ;
+    free_time_index(&db->time_index);
+    free_energy_index(&db->energy_index);
 
-                // If not found, add new buyer to the regular buyer list
-                if (!buyer) {
-                    Buyer *new_buyer = (Buyer *)malloc(sizeof(Buyer));
-                    if (!new_buyer) return;
+    db->record_list = NULL;
+    db->seller_list = NULL;
+    db->buyer_list  = NULL;
+    db->pairs_list  = NULL;
+    db->sorted_based_on = NULL_KEY;
+
+    free_hash_index(&db->tid_index);
+    free_hash_index(&db->seller_index);
+    free_hash_index(&db->buyer_index);
+    free_hash_index(&db->pair_index);
+    for (int order = 0; order < RANKING_COUNT; order++) {
+        free_top_k(&db->rankings[order]);
+    }
+    db->live_rankings = false;
+    memset(db->tid_bitmap, 0, sizeof(db->tid_bitmap));
+}
 
-                    new_buyer->BID = current_pair->BID;
-                    new_buyer->Energy = 0;  // We can update this later if needed
-                    new_buyer->next_buyer = NULL;
+///////////////////////////
+// Benchmarks, run from the command line instead of the menu
 
-                    if (prev) {
-                        prev->next_buyer = new_buyer;
-                    } else {
-                        seller->regular_buyer_list = new_buyer;
-                    }
-                }
+static double elapsed_ms(struct timespec start, struct timespec end)
+{
+    return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+// Small deterministic generator so every benchmark run sees the same data
+static unsigned int benchmark_random(unsigned int *state)
+{
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 8;
+}
+
+// Links rows synthetic records into the list, and copies them into the columns
+// when columns is not NULL. There are far fewer valid transaction IDs than rows,
+// so the rows are linked in directly instead of going through the validation of
+// the insert path.
+static void add_synthetic_records(Database *db, size_t rows, Record_columns *columns)
+{
+    unsigned int state = 2024;
+    for (size_t i = 0; i < rows; i++) {
+        Record *record = (Record*)slab_alloc(&db->record_slab);
+        if (!record) break;
+        record->transaction_id    = MIN_INPUT_NO + (int)(i % (MAX_INPUT_NO - MIN_INPUT_NO + 1));
+        record->seller_id         = MIN_INPUT_NO + (int)(benchmark_random(&state) % 1000);
+        record->buyer_id          = MIN_INPUT_NO + (int)(benchmark_random(&state) % 10000);
+        record->energy_amount     = 1.0f + (float)(benchmark_random(&state) % 100000) / 100.0f;
+        record->price_per_unit    = 1.0f + (float)(benchmark_random(&state) % 5000) / 100.0f;
+        record->transaction_money = record->energy_amount * record->price_per_unit;
+        record->unique_pair_id    = pair_key(record->seller_id, record->buyer_id);
+        time_stamp time;
+        time_fill(&time, 1 + (int)(benchmark_random(&state) % 28), 1 + (int)(benchmark_random(&state) % 12),
+                  MIN_YEAR + (int)(benchmark_random(&state) % (MAX_YEAR - MIN_YEAR + 1)),
+                  (int)(benchmark_random(&state) % 24), (int)(benchmark_random(&state) % 60));
+        record->packed_time = pack_time_stamp(time);
+        if (columns && append_record_to_columns(columns, record) == FAILURE) break;
+        record->next_record = db->record_list;
+        db->record_list     = record;
+    }
+
+}
+
+// Compares the list walk against the columnar scans on synthetic records
+int run_columnar_benchmark(size_t rows)
+{
+    Database *db = (Database*)malloc(sizeof(Database));
+    if (!db) {
+        printf("DATABASE INITIALISATION FAILED DUE TO NO FREE MEMORY :(\n");
+        return 1;
+    }
+    initialise_database(db);
+    Record_columns columns;
+    initialise_record_columns(&columns);
+    add_synthetic_records(db, rows, &columns);
+
+    const int repetitions = 5;
+    int       sid         = MIN_INPUT_NO + 7;
+    double    best[4]     = {1e30, 1e30, 1e30, 1e30};
+    volatile float sink   = 0.0f;
+    struct timespec start, end;
+
+    for (int repetition = 0; repetition < repetitions; repetition++) {
+        // sum and filter: revenue of one seller
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        sink += revenue_of_seller(db, sid);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (elapsed_ms(start, end) < best[0]) best[0] = elapsed_ms(start, end);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        sink += column_masked_sum(columns.seller_id, columns.transaction_money, columns.count, sid, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (elapsed_ms(start, end) < best[1]) best[1] = elapsed_ms(start, end);
+
+        // max: transaction with the largest energy amount
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        Record *max_energy_record = db->record_list;
+        for (Record *current = db->record_list; current; current = current->next_record) {
+            if (current->energy_amount > max_energy_record->energy_amount) {
+                max_energy_record = current;
             }
         }
-        current_pair = current_pair->next_unique_pair;
+        sink += max_energy_record->energy_amount;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (elapsed_ms(start, end) < best[2]) best[2] = elapsed_ms(start, end);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        sink += columns.energy_amount[column_index_of_maximum(columns.energy_amount, columns.count)];
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (elapsed_ms(start, end) < best[3]) best[3] = elapsed_ms(start, end);
     }
+
+    printf("Columnar store benchmark over %zu records (best of %d runs)\n", columns.count, repetitions);
+    printf("Scan                    | List walk (ms) | Columnar (ms) | Speedup\n");
+    printf("------------------------------------------------------------------\n");
+    printf("Revenue of seller       | %14.3f | %13.3f | %6.1fx\n", best[0], best[1], best[0] / best[1]);
+    printf("Maximum energy amount   | %14.3f | %13.3f | %6.1fx\n", best[2], best[3], best[2] / best[3]);
+
+    free_record_columns(&columns);
+    clear(db);
+    free(db);
+    return 0;
 }
 
+// Compares the recursive merge sort against the radix and natural merge sorts of
+// sort_records_wrapper. Every sort starts from the same insertion order, and
+// ENERGY is also timed on a list that is already nearly in order.
+int run_sort_benchmark(size_t rows)
+{
+    Database *db = (Database*)malloc(sizeof(Database));
+    Record  **original = (Record**)malloc(rows * sizeof(Record*));
+    if (!db || !original) {
+        printf("DATABASE INITIALISATION FAILED DUE TO NO FREE MEMORY :(\n");
+        free(db);
+        free(original);
+        return 1;
+    }
+    initialise_database(db);
+    add_synthetic_records(db, rows, NULL);
 
-void fill_the_price_per_unit_fields(Database *db) {
-    if (!db || !db->record_list) return;
+    size_t count = 0;
+    for (Record *current = db->record_list; current; current = current->next_record) {
+        original[count++] = current;
+    }
 
-    Record *current_record = db->record_list;
-    
-    while (current_record) {
-        // Find the seller in the seller list
-        Seller *seller = db->seller_list;
-        while (seller && seller->SID != current_record->seller_id) {
-            seller = seller->next_seller;
-        }
+    const key   keys[]      = {MONTHS, SELLER_ID, BUYER_ID, UNIQUE_PAIR_ID, TIME, ENERGY, ENERGY};
+    const char *key_names[] = {"MONTHS", "SELLER_ID", "BUYER_ID", "UNIQUE_PAIR_ID", "TIME", "ENERGY", "ENERGY (nearly sorted)"};
+    Record     *displaced   = NULL;
+    struct timespec start, end;
+
+    printf("Record sort benchmark over %zu records\n", count);
+    printf("Key                    | Merge sort (ms) | New engine (ms) | Speedup\n");
+    printf("---------------------------------------------------------------------\n");
+    for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+        double elapsed[2];
+        for (int engine = 0; engine < 2; engine++) {
+            // put the records back in insertion order before every sort
+            for (size_t i = 0; i + 1 < count; i++) {
+                original[i]->next_record = original[i + 1];
+            }
+            original[count - 1]->next_record = NULL;
+            db->record_list = original[0];
+            if (k == sizeof(keys) / sizeof(keys[0]) - 1) {
+                // nearly sorted input: sort once, then push one record out of place
+                db->record_list = sort_records(db->record_list, ENERGY);
+                displaced = db->record_list;
+                for (size_t position = 0; position < count / 2; position++) {
+                    displaced = displaced->next_record;
+                }
+                displaced->energy_amount += 10.0f;
+            }
+            db->sorted_based_on = NULL_KEY;
 
-        if (seller) {
-            // Store any recorded price in the seller's structure
-            if (current_record->energy_amount <= 300) {
-                seller->price_below_300_units = current_record->price_per_unit;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            if (engine == 0) {
+                db->record_list = sort_records(db->record_list, keys[k]);
             } else {
-                seller->price_above_300_units = current_record->price_per_unit;
+                db->record_list = sort_records_wrapper(db, keys[k]);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            elapsed[engine] = elapsed_ms(start, end);
+
+            for (Record *current = db->record_list; current && current->next_record; current = current->next_record) {
+                if (compare_records(current, current->next_record, keys[k]) > 0) {
+                    printf("ERROR: %s is not sorted by the %s engine\n", key_names[k], engine ? "new" : "merge sort");
+                    break;
+                }
+            }
+            if (displaced) {
+                displaced->energy_amount -= 10.0f;
+                displaced = NULL;
             }
         }
-        current_record = current_record->next_record;
+        printf("%-22s | %15.3f | %15.3f | %6.1fx\n", key_names[k], elapsed[0], elapsed[1], elapsed[0] / elapsed[1]);
+    }
+
+    free(original);
+    clear(db);
+    free(db);
+    return 0;
+}
+
+// Every ID with a valid check digit, in a random order
+static int* shuffled_valid_ids(unsigned int seed)
+{
+    int *ids = (int*)malloc(VALID_ID_COUNT * sizeof(int));
+    if (!ids) return NULL;
+    for (int i = 0; i < VALID_ID_COUNT; i++) {
+        int prefix = MIN_INPUT_NO / 10 + i;
+        ids[i] = prefix * 10 + calculate_check_digit(prefix);
+    }
+    for (int i = VALID_ID_COUNT - 1; i > 0; i--) {
+        int j = (int)(benchmark_random(&seed) % (unsigned int)(i + 1));
+        int temp = ids[i];
+        ids[i] = ids[j];
+        ids[j] = temp;
     }
+    return ids;
 }
 
+// Cumulative weights of count IDs: the ID of rank r is drawn with a probability
+// proportional to 1 / (r + 1)^skew, so skew 0 is uniform and skew 1 is Zipf's law
+static double* zipf_cumulative_weights(size_t count, double skew)
+{
+    double *cumulative = (double*)malloc(count * sizeof(double));
+    if (!cumulative) return NULL;
+    double total = 0.0;
+    for (size_t rank = 0; rank < count; rank++) {
+        total += pow((double)(rank + 1), -skew);
+        cumulative[rank] = total;
+    }
+    for (size_t rank = 0; rank < count; rank++) {
+        cumulative[rank] /= total;
+    }
+    return cumulative;
+}
 
-///////////////////////////
+static int draw_skewed_id(const int *ids, const double *cumulative, size_t count, unsigned int *state)
+{
+    double draw = (benchmark_random(state) + 0.5) / 16777216.0; // 24 random bits
+    size_t low = 0, high = count - 1;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (cumulative[middle] < draw) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return ids[low];
+}
 
-void clear(Database *db) {
-    if (!db) return;
+// Time of a row: the rows arrive in time order, spread evenly over MIN_YEAR..MAX_YEAR.
+// Months are cut to 28 days so that every time is valid.
+static time_stamp benchmark_row_time(size_t row, size_t rows)
+{
+    const uint64_t minutes = (uint64_t)(MAX_YEAR - MIN_YEAR + 1) * 12 * 28 * 24 * 60;
+    uint64_t minute = (uint64_t)row * minutes / rows;
+    time_stamp time;
+    time_fill(&time, 1 + (int)(minute / (24 * 60) % 28), 1 + (int)(minute / (28 * 24 * 60) % 12),
+              MIN_YEAR + (int)(minute / (12 * 28 * 24 * 60)), (int)(minute / 60 % 24), (int)(minute % 60));
+    return time;
+}
 
-    // Free the Record list
-    Record *current_record = db->record_list;
-    while (current_record) {
-        Record *temp = current_record;
-        current_record = current_record->next_record;
-        free(temp);
+// Transaction ID of a row. There are only VALID_ID_COUNT valid 6 digit IDs, the
+// rows after them get IDs from MAX_INPUT_NO + 1 up, a range only the benchmark uses,
+// so that every row still has its own ID in the transaction ID and energy indexes.
+static int benchmark_transaction_id(const Benchmark_generator *generator, size_t row)
+{
+    if (row < VALID_ID_COUNT) return generator->transaction_ids[row];
+    return MAX_INPUT_NO + 1 + (int)(row - VALID_ID_COUNT);
+}
+
+static void generate_benchmark_transactions(Benchmark_generator *generator, Benchmark_transaction *transactions,
+                                            size_t first_row, size_t count, size_t rows)
+{
+    for (size_t i = 0; i < count; i++) {
+        Benchmark_transaction *transaction = &transactions[i];
+        transaction->TID  = benchmark_transaction_id(generator, first_row + i);
+        transaction->SID  = draw_skewed_id(generator->seller_ids, generator->seller_weights, generator->sellers, &generator->state);
+        transaction->BID  = draw_skewed_id(generator->buyer_ids, generator->buyer_weights, generator->buyers, &generator->state);
+        transaction->EA   = 1.0f + (float)(benchmark_random(&generator->state) % 100000) / 100.0f;
+        transaction->PPU  = 1.0f + (float)(benchmark_random(&generator->state) % 5000) / 100.0f;
+        transaction->time = benchmark_row_time(first_row + i, rows);
     }
-    db->record_list = NULL;
+}
 
-    // Free the Seller list
-    Seller *current_seller = db->seller_list;
-    while (current_seller) {
-        // Free the regular_buyer_list for each seller
-        Buyer *current_buyer = current_seller->regular_buyer_list;
-        while (current_buyer) {
-            Buyer *temp = current_buyer;
-            current_buyer = current_buyer->next_buyer;
-            free(temp);
-        }
-        Seller *temp = current_seller;
-        current_seller = current_seller->next_seller;
-        free(temp);
+// One member of the operations object of a run
+static void write_benchmark_timing(FILE *out, bool *first, const char *name, size_t operations, double ms)
+{
+    fprintf(out, "%s        \"%s\": {\"operations\": %zu, \"ms\": %.3f, \"ns_per_operation\": %.1f}",
+            *first ? "" : ",\n", name, operations, ms, operations ? ms * 1e6 / (double)operations : 0.0);
+    *first = false;
+}
+
+// Times every operation of the Database on rows synthetic transactions and writes
+// the timings as one JSON object. Only VALID_ID_COUNT transaction IDs exist, so the
+// first VALID_ID_COUNT rows go through insert_record_into_record_list. The rest get
+// wider IDs (see benchmark_transaction_id) that validity_checker would reject, and
+// go through add_validated_record, which keeps every index but skips the checks.
+static int benchmark_database_rows(FILE *out, Benchmark_generator *generator, size_t rows)
+{
+    Database              *db           = (Database*)malloc(sizeof(Database));
+    Record               **order        = (Record**)malloc(rows * sizeof(Record*));
+    Benchmark_transaction *transactions = (Benchmark_transaction*)malloc(BENCHMARK_CHUNK_ROWS * sizeof(Benchmark_transaction));
+    if (!db || !order || !transactions) {
+        printf("DATABASE INITIALISATION FAILED DUE TO NO FREE MEMORY :(\n");
+        free(db);
+        free(order);
+        free(transactions);
+        return 1;
     }
-    db->seller_list = NULL;
+    initialise_database(db);
+    generator->state = 2024; // the same transactions for a row count in every run
+
+    size_t validated = rows < VALID_ID_COUNT ? rows : VALID_ID_COUNT;
+    size_t failed    = 0;
+    double ms[2]     = {0.0, 0.0};
+    volatile float sink = 0.0f;
+    struct timespec start, end;
+    bool first = true;
+
+    // insert, generating the transactions chunk by chunk outside the timed loops
+    for (size_t first_row = 0; first_row < rows; first_row += BENCHMARK_CHUNK_ROWS) {
+        size_t count = rows - first_row < BENCHMARK_CHUNK_ROWS ? rows - first_row : BENCHMARK_CHUNK_ROWS;
+        size_t split = validated > first_row ? (validated - first_row < count ? validated - first_row : count) : 0;
+        generate_benchmark_transactions(generator, transactions, first_row, count, rows);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < split; i++) {
+            Benchmark_transaction *t = &transactions[i];
+            if (insert_record_into_record_list(db, t->TID, t->SID, t->BID, t->EA, t->PPU, &t->time, &db->record_list) == FAILURE) failed++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ms[0] += elapsed_ms(start, end);
 
-    // Free the Buyer list
-    Buyer *current_buyer = db->buyer_list;
-    while (current_buyer) {
-        Buyer *temp = current_buyer;
-        current_buyer = current_buyer->next_buyer;
-        free(temp);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = split; i < count; i++) {
+            Benchmark_transaction *t = &transactions[i];
+            if (add_validated_record(db, t->TID, t->SID, t->BID, t->EA, t->PPU, pack_time_stamp(t->time), false, &db->record_list) == FAILURE) failed++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        ms[1] += elapsed_ms(start, end);
+    }
+    if (failed) {
+        printf("ERROR: %zu of %zu synthetic transactions were not inserted\n", failed, rows);
     }
-    db->buyer_list = NULL;
 
-    // Free the Pair list
-    Pair *current_pair = db->pairs_list;
-    while (current_pair) {
-        Pair *temp = current_pair;
-        current_pair = current_pair->next_unique_pair;
-        free(temp);
+    size_t count = 0;
+    for (Record *current = db->record_list; current; current = current->next_record) {
+        order[count++] = current;
     }
-    db->pairs_list = NULL;
 
-    // Free the hash table
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        transaction_hash_node *current_node = db->hashTable[i];
-        while (current_node) {
-            transaction_hash_node *temp = current_node;
-            current_node = current_node->next;
-            free(temp);
+    fprintf(out, "    {\n      \"rows\": %zu,\n      \"validated_rows\": %zu,\n      \"operations\": {\n", rows, validated);
+    write_benchmark_timing(out, &first, "insert", validated, ms[0]);
+    if (rows > validated) {
+        write_benchmark_timing(out, &first, "insert_unvalidated", rows - validated, ms[1]);
+    }
+
+    // uniqueness of every valid transaction ID, answered by the bitmap and by the hash index
+    const uniqueness_mode modes[]      = {BITMAP_LOOKUP, HASH_INDEX_LOOKUP};
+    const char           *mode_names[] = {"uniqueness_bitmap", "uniqueness_hash_index"};
+    for (int mode = 0; mode < 2; mode++) {
+        size_t unique = 0;
+        db->unique_check = modes[mode];
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < VALID_ID_COUNT; i++) {
+            unique += is_transaction_id_input_unique(db, generator->transaction_ids[i]);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (unique != VALID_ID_COUNT - validated) {
+            printf("ERROR: %s found %zu unique IDs instead of %zu\n", mode_names[mode], unique, (size_t)VALID_ID_COUNT - validated);
+            failed++;
+        }
+        write_benchmark_timing(out, &first, mode_names[mode], VALID_ID_COUNT, elapsed_ms(start, end));
+    }
+    db->unique_check = BITMAP_LOOKUP;
+
+    // new energy amount and price for every transaction ID; the time stays, a new time
+    // of a record that is not the latest one would move the rest of the time index
+    double update_ms = 0.0;
+    for (size_t first_row = 0; first_row < validated; first_row += BENCHMARK_CHUNK_ROWS) {
+        size_t chunk = validated - first_row < BENCHMARK_CHUNK_ROWS ? validated - first_row : BENCHMARK_CHUNK_ROWS;
+        generate_benchmark_transactions(generator, transactions, first_row, chunk, rows);
+        for (size_t i = 0; i < chunk; i++) {
+            transactions[i].time = unpack_time_stamp(get_transaction(db, transactions[i].TID)->packed_time);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t i = 0; i < chunk; i++) {
+            Benchmark_transaction *t = &transactions[i];
+            if (update_existing_transaction(db, t->TID, t->EA, t->PPU, t->time) == FAILURE) failed++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        update_ms += elapsed_ms(start, end);
+    }
+    size_t in_energy_order = 0;
+    for (const Energy_index_node *node = energy_index_first(&db->energy_index); node; node = node->forward[0]) {
+        if (node->record->energy_amount != node->energy_amount) break;
+        in_energy_order++;
+    }
+    if (in_energy_order != count || db->energy_index.count != count) {
+        printf("ERROR: the energy index holds %zu current records of %zu after the updates\n", in_energy_order, count);
+        failed++;
+    }
+    write_benchmark_timing(out, &first, "update_existing_transaction", validated, update_ms);
+
+    // the walk of display_records_between_time over every month, without the printf
+    size_t visited = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int year = MIN_YEAR; year <= MAX_YEAR; year++) {
+        for (int month = 1; month <= 12; month++) {
+            time_stamp t1, t2;
+            time_fill(&t1, 1, month, year, 0, 0);
+            time_fill(&t2, 28, month, year, 23, 59);
+            Time_range_iterator range = records_between_time(db, t1, t2);
+            Record *current;
+            while ((current = next_record_in_time_range(&range))) {
+                time_stamp time = unpack_time_stamp(current->packed_time);
+                sink += current->energy_amount + (float)time.date;
+                visited++;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (visited != count) {
+        printf("ERROR: the monthly time ranges visited %zu of %zu records\n", visited, count);
+        failed++;
+    }
+    write_benchmark_timing(out, &first, "records_between_time", (size_t)(MAX_YEAR - MIN_YEAR + 1) * 12, elapsed_ms(start, end));
+
+    // every key, each sort starting from the insertion order
+    const key   keys[]      = {MONTHS, SELLER_ID, BUYER_ID, UNIQUE_PAIR_ID, TIME, ENERGY};
+    const char *key_names[] = {"sort_months", "sort_seller_id", "sort_buyer_id", "sort_unique_pair_id", "sort_time", "sort_energy"};
+    for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+        for (size_t i = 0; i + 1 < count; i++) {
+            order[i]->next_record = order[i + 1];
+        }
+        order[count - 1]->next_record = NULL;
+        db->record_list     = order[0];
+        db->sorted_based_on = NULL_KEY;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        db->record_list = sort_records_wrapper(db, keys[k]);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        for (Record *current = db->record_list; current && current->next_record; current = current->next_record) {
+            if (compare_records(current, current->next_record, keys[k]) > 0) {
+                printf("ERROR: the records are not sorted by %s\n", key_names[k]);
+                failed++;
+                break;
+            }
         }
-        db->hashTable[i] = NULL;
+        write_benchmark_timing(out, &first, key_names[k], count, elapsed_ms(start, end));
+    }
+
+    // rebuilding the aggregates from the records
+    void      (*rebuilds[])(Database*) = {populate_seller_list, populate_buyer_list, populate_pairs_list};
+    const char *rebuild_names[]        = {"populate_seller_list", "populate_buyer_list", "populate_pairs_list"};
+    for (int rebuild = 0; rebuild < 3; rebuild++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        rebuilds[rebuild](db);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        write_benchmark_timing(out, &first, rebuild_names[rebuild], count, elapsed_ms(start, end));
     }
-    Database* temp = db ;
+    fprintf(out, "\n      }\n    }");
+
+    free(transactions);
+    free(order);
+    clear(db);
     free(db);
-    temp = NULL;
+    return failed ? 1 : 0;
+}
+
+// Times insert, uniqueness checks, updates, time range walks, sorts and aggregate
+// rebuilds on synthetic transactions for every row count, and writes the timings
+// as JSON so that two runs can be diffed. The seller and buyer IDs are drawn from
+// options->sellers and options->buyers valid IDs with a Zipf skew of options->skew.
+int run_database_benchmark(const size_t *row_counts, size_t runs, const Database_benchmark_options *options)
+{
+    Benchmark_generator generator;
+    generator.sellers = options->sellers < 1 ? 1 : (options->sellers > VALID_ID_COUNT ? VALID_ID_COUNT : options->sellers);
+    generator.buyers  = options->buyers  < 1 ? 1 : (options->buyers  > VALID_ID_COUNT ? VALID_ID_COUNT : options->buyers);
+    generator.transaction_ids = shuffled_valid_ids(1);
+    generator.seller_ids      = shuffled_valid_ids(2);
+    generator.buyer_ids       = shuffled_valid_ids(3);
+    generator.seller_weights  = zipf_cumulative_weights(generator.sellers, options->skew);
+    generator.buyer_weights   = zipf_cumulative_weights(generator.buyers, options->skew);
+
+    FILE *out    = options->json_path ? fopen(options->json_path, "w") : stdout;
+    int   result = 1;
+    if (!out) {
+        printf("Cannot open %s\n", options->json_path);
+    } else if (!generator.transaction_ids || !generator.seller_ids || !generator.buyer_ids ||
+               !generator.seller_weights || !generator.buyer_weights) {
+        printf("DATABASE INITIALISATION FAILED DUE TO NO FREE MEMORY :(\n");
+    } else {
+        fprintf(out, "{\n  \"benchmark\": \"database\",\n  \"sellers\": %zu,\n  \"buyers\": %zu,\n  \"skew\": %.3f,\n"
+                     "  \"unvalidated_transaction_ids\": \"unique, from %d up, outside the range of valid IDs\",\n  \"runs\": [\n",
+                generator.sellers, generator.buyers, options->skew, MAX_INPUT_NO + 1);
+        size_t written = 0;
+        result = 0;
+        for (size_t run = 0; run < runs; run++) {
+            if (row_counts[run] == 0) continue;
+            if (written++ > 0) fprintf(out, ",\n");
+            result |= benchmark_database_rows(out, &generator, row_counts[run]);
+            fflush(out);
+        }
+        fprintf(out, "\n  ]\n}\n");
+    }
+    if (out && out != stdout) {
+        fclose(out);
+    }
+    free(generator.transaction_ids);
+    free(generator.seller_ids);
+    free(generator.buyer_ids);
+    free(generator.seller_weights);
+    free(generator.buyer_weights);
+    return result;
 }
 
 ///////////////////////////
 ///////////////////////////
 
-int main() {
+int main(int argc, char *argv[]) {
     // Initialize the database
     Database db;
     initialise_database(&db);
+    size_t wal_sync_bytes = WAL_DEFAULT_SYNC_BYTES;
+    long   wal_sync_ms    = WAL_DEFAULT_SYNC_MS;
+    bool   loaded         = false; // a --load came first, its transactions could not be logged
+    Database_benchmark_options bench_options = {1000, 10000, 0.0, NULL}; // the cardinalities of add_synthetic_records
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "--hash-uniqueness") == 0) {
+            // answer uniqueness checks from the hash index instead of the bitmap
+            db.unique_check = HASH_INDEX_LOOKUP;
+        } else if (strcmp(argv[arg], "--load") == 0 && arg + 1 < argc) {
+            // stream a file of transactions into the Database before the menu starts
+            Bulk_load_summary summary;
+            const char *path = argv[++arg];
+            loaded = true;
+            if (bulk_load_transactions(&db, path, &summary) == FAILURE) {
+                printf("Loading %s failed\n", path);
+            }
+            display_bulk_load_summary(path, &summary);
+            size_t ids_in_use = count_used_transaction_ids(&db) +
+                                db.snapshot.row_count - db.snapshot.materialized_count;
+            printf("%zu of the %d valid transaction IDs are in use\n", ids_in_use, VALID_ID_COUNT);
+        } else if (strcmp(argv[arg], "--wal-sync-bytes") == 0 && arg + 1 < argc) {
+            wal_sync_bytes = strtoul(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "--wal-sync-ms") == 0 && arg + 1 < argc) {
+            wal_sync_ms = strtol(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "--snapshot") == 0 && arg + 1 < argc) {
+            // start from a saved snapshot, its rows become records when a query needs them
+            if (open_snapshot(&db, argv[++arg]) == FAILURE) {
+                clear(&db);
+                return 1;
+            }
+        } else if (strcmp(argv[arg], "--wal") == 0 && arg + 1 < argc) {
+            // replay the log and make every following insert and update durable in it
+            if (loaded) {
+                printf("Give --wal before --load, or the loaded transactions are not logged\n");
+                clear(&db);
+                return 1;
+            }
+            if (open_write_ahead_log(&db, argv[++arg], wal_sync_bytes, wal_sync_ms) == FAILURE) {
+                clear(&db);
+                return 1;
+            }
+        } else if (strcmp(argv[arg], "--live-top-k") == 0 && arg + 1 < argc) {
+            // keep the top K pairs and sellers current on every insert and update
+            enable_live_rankings(&db, strtoul(argv[++arg], NULL, 10));
+        } else if (strcmp(argv[arg], "--bench-columnar") == 0) {
+            int result = 0;
+            if (arg + 1 < argc) {
+                result = run_columnar_benchmark(strtoul(argv[arg + 1], NULL, 10));
+            } else {
+                result = run_columnar_benchmark(1000000) || run_columnar_benchmark(10000000);
+            }
+            clear(&db);
+            return result;
+        } else if (strcmp(argv[arg], "--bench-sellers") == 0 && arg + 1 < argc) {
+            bench_options.sellers = strtoul(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "--bench-buyers") == 0 && arg + 1 < argc) {
+            bench_options.buyers = strtoul(argv[++arg], NULL, 10);
+        } else if (strcmp(argv[arg], "--bench-skew") == 0 && arg + 1 < argc) {
+            bench_options.skew = strtod(argv[++arg], NULL);
+        } else if (strcmp(argv[arg], "--bench-json") == 0 && arg + 1 < argc) {
+            bench_options.json_path = argv[++arg];
+        } else if (strcmp(argv[arg], "--bench-db") == 0) {
+            size_t default_rows[] = {10000, 1000000, 10000000};
+            size_t rows           = arg + 1 < argc ? strtoul(argv[arg + 1], NULL, 10) : 0;
+            int result = arg + 1 < argc ? run_database_benchmark(&rows, 1, &bench_options)
+                                        : run_database_benchmark(default_rows, 3, &bench_options);
+            clear(&db);
+            return result;
+        } else if (strcmp(argv[arg], "--bench-sort") == 0) {
+            size_t rows = arg + 1 < argc ? strtoul(argv[arg + 1], NULL, 10) : 1000000;
+            int result = run_sort_benchmark(rows);
+            clear(&db);
+            return result;
+        } else {
+            printf("Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
 
     // Initialize some transactions
     time_stamp ts1, ts2, ts3, ts4, ts5, ts6, ts7, ts8, ts9, ts10, ts11, ts12;
@@ -1418,19 +4380,21 @@ int main() {
     time_fill(&ts12, 22, 5, 2023, 20, 0);
 
 
-    // Insert some initial records
-    insert_record_into_record_list(&db, 123455, 123455, 123400, 18.5, 20.0, &ts1 , &db.record_list);
-	insert_record_into_record_list(&db, 164832, 356872, 176581, 57.9, 15.0, &ts2 , &db.record_list);
-	insert_record_into_record_list(&db, 234551, 536806, 304937, 57.9, 15.0, &ts3 , &db.record_list);
-	insert_record_into_record_list(&db, 300002, 200030, 100004, 18.5, 20.0, &ts4 , &db.record_list);
-	insert_record_into_record_list(&db, 456783, 654311, 789125, 45.2, 30.0, &ts5 , &db.record_list);
-	insert_record_into_record_list(&db, 567898, 987644, 123780, 78.1, 12.5, &ts6 , &db.record_list);
-	insert_record_into_record_list(&db, 678902, 345686, 567127, 33.3, 25.4, &ts7 , &db.record_list);
-	insert_record_into_record_list(&db, 789018, 123469, 678911, 91.2, 10.1, &ts8 , &db.record_list);
-	insert_record_into_record_list(&db, 890123, 234573, 789349, 66.7, 44.8, &ts9 , &db.record_list);
-	insert_record_into_record_list(&db, 901237, 345686, 890562, 54.5, 28.9, &ts10, &db.record_list);
-	insert_record_into_record_list(&db, 345677, 456794, 901786, 99.9, 05.0, &ts11, &db.record_list);
-	insert_record_into_record_list(&db, 456783, 567802, 123890, 12.3, 32.1, &ts12, &db.record_list);
+    // Insert some initial records, unless the Database was already filled from a snapshot, a log or a load file
+    if (db.record_list == NULL && db.snapshot.map == NULL) {
+        insert_record_into_record_list(&db, 123455, 123455, 123400, 18.5, 20.0, &ts1 , &db.record_list);
+        insert_record_into_record_list(&db, 164832, 356872, 176581, 57.9, 15.0, &ts2 , &db.record_list);
+        insert_record_into_record_list(&db, 234551, 536806, 304937, 57.9, 15.0, &ts3 , &db.record_list);
+        insert_record_into_record_list(&db, 300002, 200030, 100004, 18.5, 20.0, &ts4 , &db.record_list);
+        insert_record_into_record_list(&db, 456783, 654311, 789125, 45.2, 30.0, &ts5 , &db.record_list);
+        insert_record_into_record_list(&db, 567898, 987644, 123780, 78.1, 12.5, &ts6 , &db.record_list);
+        insert_record_into_record_list(&db, 678902, 345686, 567127, 33.3, 25.4, &ts7 , &db.record_list);
+        insert_record_into_record_list(&db, 789018, 123469, 678911, 91.2, 10.1, &ts8 , &db.record_list);
+        insert_record_into_record_list(&db, 890123, 234573, 789349, 66.7, 44.8, &ts9 , &db.record_list);
+        insert_record_into_record_list(&db, 901237, 345686, 890562, 54.5, 28.9, &ts10, &db.record_list);
+        insert_record_into_record_list(&db, 345677, 456794, 901786, 99.9, 05.0, &ts11, &db.record_list);
+        insert_record_into_record_list(&db, 456783, 567802, 123890, 12.3, 32.1, &ts12, &db.record_list);
+    }
 
 
     int choice;
@@ -1447,9 +4411,21 @@ int main() {
         printf("5. View Seller/Buyer Statistics\n");
         printf("6. View Pair Analysis\n");
         printf("7. Update existing Transaction.\n");
+        printf("8. View Top N Transactions by Energy Amount\n");
+        printf("9. View Transactions above an Energy Amount\n");
+        printf("10. Save Snapshot\n");
+        printf("11. Save Snapshot in Background\n");
         printf("0. Exit\n");
         printf("\nEnter your choice: ");
+        sync_write_ahead_log(&db.log); // nothing waits for its fsync while the menu waits for input
         scanf("%d", &choice);
+        finish_background_save(&db, false);
+
+        if (choice == 5 || choice == 6) {
+            // the statistics need every row in the aggregates, the other queries read the
+            // snapshot rows from the mapping or only load the row they update
+            materialize_snapshot(&db);
+        }
 
         switch (choice) {
             case 1: {
@@ -1520,30 +4496,32 @@ int main() {
                 printf("1. View Sorted Seller List (by Revenue)\n");
                 printf("2. View Sorted Buyer List (by Energy)\n");
                 printf("3. Query Revenue of a Seller\n");
+                printf("4. View Top K Sellers (by Revenue)\n");
                 printf("Enter choice: ");
                 scanf("%d", &sub_choice);
 
+                // seller revenue, buyer energy and regular buyers are kept current by every insert and update
                 if (sub_choice == 1) {
-                    populate_seller_list(&db)                        ;
-                    populate_pairs_list(&db)                         ;
-                    fill_the_regular_buyers_list_in_seller_nodes(&db);
-                    fill_the_price_per_unit_fields(&db)              ;
                     sort_sellers_by_revenue(&db)                     ;
                     display_sellers_list(&db)                        ;
                 } else if (sub_choice == 2) {
                     printf("Buyers list sorted and diplayed as per Energy Amount is:\n\n");
-                    populate_buyer_list(&db)  ;
                     sort_buyers_by_energy(&db);
                     display_buyers_list(&db)  ;
                 } else if (sub_choice == 3) {
-                    populate_seller_list(&db)                        ;
-                    populate_pairs_list(&db)                         ;
-                    fill_the_regular_buyers_list_in_seller_nodes(&db);
-                    fill_the_price_per_unit_fields(&db)              ;
                     int sid;
                     printf("Enter Seller ID: ");
                     scanf("%d", &sid);
-                    printf("The revenue of this seller is: %.2f\n", revenue_of_seller(&db, sid));
+                    Seller *seller = get_seller(&db, sid);
+                    if (!seller) {
+                        printf("The seller (ID: %d) does not exist in the transaction records.\n", sid);
+                    }
+                    printf("The revenue of this seller is: %.2f\n", seller ? seller->Revenue : 0.0f);
+                } else if (sub_choice == 4) {
+                    int k;
+                    printf("Enter K: ");
+                    scanf("%d", &k);
+                    display_top_k(&db, SELLERS_BY_REVENUE, k > 0 ? (size_t)k : 0);
                 } else {
                     printf("Invalid choice. Please try again.\n");
                 }
@@ -1555,11 +4533,12 @@ int main() {
                 printf("\nPair Analysis:\n");
                 printf("1. Find Pair with Maximum Transactions\n");
                 printf("2. View Pairs Sorted by Transaction Count\n");
+                printf("3. View Top K Pairs (by Transaction Count)\n");
+                printf("4. View Top K Pairs (by Revenue)\n");
                 printf("Enter choice: ");
                 scanf("%d", &sub_choice);
 
-                filling_pairs(&db);
-
+                // the pair counts are kept current by every insert, only the pairs themselves are sorted
                 if (sub_choice == 1) {
                     Pair* max_pair = find_pair_that_has_maximum_transactions(&db);
                     if (max_pair) {
@@ -1571,6 +4550,12 @@ int main() {
                 } else if (sub_choice == 2) {
                     sort_pairs_list_based_on_number_of_transactions(&db);
                     display_sorted_pairs(&db);
+                } else if (sub_choice == 3 || sub_choice == 4) {
+                    int k;
+                    printf("Enter K: ");
+                    scanf("%d", &k);
+                    display_top_k(&db, sub_choice == 3 ? PAIRS_BY_TRANSACTIONS : PAIRS_BY_REVENUE,
+                                  k > 0 ? (size_t)k : 0);
                 } else {
                     printf("Invalid choice. Please try again.\n");
                 }
@@ -1604,6 +4589,38 @@ int main() {
                 }
                 break;
             }
+            case 8: {
+                int n;
+                printf("Enter N: ");
+                scanf("%d", &n);
+                display_records_with_most_energy(&db, n > 0 ? (size_t)n : 0);
+                break;
+            }
+            case 9: {
+                float minimum;
+                printf("Enter Energy Amount (kWh): ");
+                scanf("%f", &minimum);
+                display_records_above_energy(&db, minimum);
+                break;
+            }
+            case 10: {
+                char path[MAX_LINE_LENGTH];
+                printf("Enter Snapshot File: ");
+                scanf("%99s", path);
+                if (save_snapshot(&db, path) == SUCCESS) {
+                    printf("Snapshot saved to %s\n", path);
+                }
+                break;
+            }
+            case 11: {
+                char path[MAX_LINE_LENGTH];
+                printf("Enter Snapshot File: ");
+                scanf("%99s", path);
+                if (save_snapshot_in_background(&db, path) == SUCCESS) {
+                    printf("Saving the snapshot to %s in the background\n", path);
+                }
+                break;
+            }
             case 0:
                 // Free allocated memory before exiting
                 printf("\nExiting program in 1..2..3...EXITED:)\n");
@@ -1,105 +1,386 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "verhoeff_batch.h"
 
 #define MAX_LINE_LENGTH 100
+#define MAX_OUTPUT_ENTRY 32          // room for the longest line written for one entry, "12345x, 12345x, 12345x\n"
+#define CHUNK_SIZE       (1 << 22)   // bytes of input one worker validates at a time
+#define OUTPUT_BUFFER    (1 << 20)   // stdio buffer of output.txt
+#define ENTRY_BATCH      1024        // entries whose check digits are computed together
 
-// Dihedral permutation table
-static const int permuatation_table[8][10] = {
-    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
-    {1, 5, 7, 6, 2, 8, 3, 0, 9, 4},
-    {5, 8, 0, 3, 7, 9, 6, 1, 4, 2},
-    {8, 9, 1, 6, 0, 4, 3, 5, 2, 7},
-    {9, 4, 5, 3, 1, 2, 6, 8, 7, 0},
-    {4, 2, 8, 6, 5, 7, 3, 9, 0, 1},
-    {2, 7, 9, 3, 8, 0, 6, 4, 1, 5},
-    {7, 0, 4, 6, 9, 1, 3, 2, 5, 8}
-};
-
-// Non-commutative multiplication table (D5 group)
-static const int d5_mult_table[10][10] = {
-    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
-    {1, 2, 3, 4, 0, 6, 7, 8, 9, 5},
-    {2, 3, 4, 0, 1, 7, 8, 9, 5, 6},
-    {3, 4, 0, 1, 2, 8, 9, 5, 6, 7},
-    {4, 0, 1, 2, 3, 9, 5, 6, 7, 8},
-    {5, 9, 8, 7, 6, 0, 4, 3, 2, 1},
-    {6, 5, 9, 8, 7, 1, 0, 4, 3, 2},
-    {7, 6, 5, 9, 8, 2, 1, 0, 4, 3},
-    {8, 7, 6, 5, 9, 3, 2, 1, 0, 4},
-    {9, 8, 7, 6, 5, 4, 3, 2, 1, 0}
-};
-
-// Inverse lookup table
-static const int inv_table[10] = {0, 4, 3, 2, 1, 5, 9, 8, 7, 6};
-
-// Implementation of f(a,b)
-static int f(int a, int b) {
-    return d5_mult_table[a][permuatation_table[0][b]];
-}
-
-int calculate_check_digit(int number) {
-    if (number < 10000 || number > 99999) return -1;
-    
-    int a1 = (number / 10000) % 10;
-    int a2 = (number / 1000) % 10;
-    int a3 = (number / 100) % 10;
-    int a4 = (number / 10) % 10;
-    int a5 = number % 10;
-    
-    // Calculate c = f(a1, f(a2, f(a3, f(a4, a5))))
-    int c = f(a1, f(a2, f(a3, f(a4, a5))));
-    
-    // Return inverse of c
-    return inv_table[c];
-}
 // Function to check if an ID is a valid five-digit number (10000-99999)
 int is_valid_id(int num) {
     return num >= 10000 && num <= 99999;
 }
 
-int main() {
-    FILE *input_file = fopen("input.txt", "r");
-    FILE *output_file = fopen("output.txt", "w");
-    if (!input_file || !output_file) {
+// Whitespace as isspace() sees it in the C locale, which is what a space in a scanf format skips
+static bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// The line ends at end or at a NUL byte, like the string fgets leaves for sscanf
+static const char *skip_blanks(const char *p, const char *end) {
+    while (p < end && is_blank(*p)) p++;
+    return p;
+}
+
+// Parse "TID , SID , BID" the way sscanf(line, " %5[0-9] , %5[0-9] , %5[0-9] %s") == 3
+// accepted it: whitespace around the commas, 1 to 5 digits per number and nothing
+// but whitespace after the third one. ids[k] points at the digits of number k.
+static bool parse_entry(const char *p, const char *end, const char *ids[3], int lengths[3]) {
+    p = skip_blanks(p, end);
+    for (int k = 0; k < 3; k++) {
+        if (k > 0) {
+            p = skip_blanks(p, end);
+            if (p == end || *p != ',') return false;
+            p = skip_blanks(p + 1, end);
+        }
+        ids[k] = p;
+        while (p < end && p - ids[k] < 5 && *p >= '0' && *p <= '9') p++;
+        lengths[k] = (int)(p - ids[k]);
+        if (lengths[k] == 0) return false;
+    }
+    p = skip_blanks(p, end);
+    return p == end || *p == '\0';
+}
+
+// Entries are parsed one at a time, and the check digits of ENTRY_BATCH entries are
+// computed by one verhoeff_check_digits_batch call over all their IDs (with AVX2
+// gathers when the CPU has them). The lines of output.txt are written afterwards.
+typedef struct Entry_batch_tag
+{
+    int32_t prefixes[3 * ENTRY_BATCH] ;//the three IDs of every entry, 0 for an INVALID ENTRY
+    int8_t  checks[3 * ENTRY_BATCH]   ;
+    bool    valid[ENTRY_BATCH]        ;
+    size_t  count                     ;//entries in the batch
+}Entry_batch;
+
+// Parse one entry (the bytes fgets would return, without the NUL) into the batch,
+// which must have room for it
+static void batch_entry(Entry_batch *batch, const char *line, const char *end) {
+    const char *ids[3];
+    int lengths[3];
+    int32_t *prefixes = &batch->prefixes[3 * batch->count];
+
+    // Strict format check, and every ID must be a five-digit number (10000-99999)
+    bool valid = parse_entry(line, end, ids, lengths);
+    for (int k = 0; k < 3; k++) {
+        int32_t number = 0;
+        for (int i = 0; valid && i < lengths[k]; i++) {
+            number = number * 10 + (ids[k][i] - '0');
+        }
+        valid = valid && is_valid_id(number);
+        prefixes[k] = number;
+    }
+    if (!valid) {
+        prefixes[0] = prefixes[1] = prefixes[2] = 0;
+    }
+    batch->valid[batch->count++] = valid;
+}
+
+// Compute the check digits of the batch, write its lines of output.txt into out
+// (room for ENTRY_BATCH * MAX_OUTPUT_ENTRY bytes) and empty it. Returns the length written.
+static size_t flush_entry_batch(Entry_batch *batch, char *out) {
+    verhoeff_check_digits_batch(batch->prefixes, batch->checks, 3 * batch->count);
+
+    char *o = out;
+    for (size_t entry = 0; entry < batch->count; entry++) {
+        if (!batch->valid[entry]) {
+            memcpy(o, "INVALID ENTRY\n", 14);
+            o += 14;
+            continue;
+        }
+        // "%05d%d, %05d%d, %05d%d\n"
+        for (int k = 0; k < 3; k++) {
+            int32_t number = batch->prefixes[3 * entry + k];
+            for (int digit = 4; digit >= 0; digit--) {
+                o[digit] = (char)('0' + number % 10);
+                number /= 10;
+            }
+            o[5] = (char)('0' + batch->checks[3 * entry + k]);
+            if (k < 2) {
+                o[6] = ',';
+                o[7] = ' ';
+                o += 8;
+            } else {
+                o[6] = '\n';
+                o += 7;
+            }
+        }
+    }
+    batch->count = 0;
+    return (size_t)(o - out);
+}
+
+// Length of the piece fgets(line, MAX_LINE_LENGTH, ...) would return at data:
+// up to and including the next newline, but never more than MAX_LINE_LENGTH - 1 bytes
+static size_t next_entry_length(const char *data, size_t remaining) {
+    size_t limit = remaining < MAX_LINE_LENGTH - 1 ? remaining : MAX_LINE_LENGTH - 1;
+    const char *newline = memchr(data, '\n', limit);
+    return newline ? (size_t)(newline - data) + 1 : limit;
+}
+
+//////////////////////////
+// multithreaded mode: the input is mapped and cut into chunks that start right
+// after a newline, so fgets would split every chunk into the same pieces as the
+// whole file. Workers fill one output buffer per chunk, the main thread writes
+// them out in order.
+
+typedef struct Output_slot_tag
+{
+    char   *data     ;
+    size_t  length   ;
+    size_t  capacity ;
+    bool    done     ;//the chunk is validated and waiting to be written
+}Output_slot;
+
+typedef struct Parallel_validator_tag
+{
+    const char     *input        ;
+    size_t          size         ;
+    size_t          start        ;//first byte after the skipped header line
+    size_t          chunk_count  ;
+    size_t          next_chunk   ;//next chunk a worker takes
+    size_t          written      ;//chunks already written, in order
+    size_t          window       ;//chunks that may be ahead of the writer
+    Output_slot    *slots        ;//chunk c is in slots[c % window]
+    bool            failed       ;
+    pthread_mutex_t lock         ;
+    pthread_cond_t  chunk_done   ;
+    pthread_cond_t  slot_free    ;
+}Parallel_validator;
+
+// Where chunk c starts: the first line start at or after c * CHUNK_SIZE
+static size_t chunk_boundary(const Parallel_validator *validator, size_t chunk) {
+    if (chunk == 0) return validator->start;
+    if (chunk >= validator->chunk_count) return validator->size;
+    size_t position = chunk * CHUNK_SIZE;
+    const char *newline = memchr(validator->input + position - 1, '\n', validator->size - position + 1);
+    size_t boundary = newline ? (size_t)(newline - validator->input) + 1 : validator->size;
+    return boundary < validator->start ? validator->start : boundary;
+}
+
+static bool validate_chunk(const Parallel_validator *validator, size_t chunk, Output_slot *slot) {
+    size_t position = chunk_boundary(validator, chunk);
+    size_t end      = chunk_boundary(validator, chunk + 1);
+    Entry_batch batch;
+    batch.count = 0;
+
+    slot->length = 0;
+    while (position < end || batch.count > 0) {
+        if (position < end && batch.count < ENTRY_BATCH) {
+            const char *entry = validator->input + position;
+            size_t length = next_entry_length(entry, end - position);
+            batch_entry(&batch, entry, entry + length);
+            position += length;
+            continue;
+        }
+        if (slot->capacity - slot->length < ENTRY_BATCH * MAX_OUTPUT_ENTRY) {
+            size_t capacity = slot->capacity ? 2 * slot->capacity : 2 * CHUNK_SIZE;
+            char  *grown    = realloc(slot->data, capacity);
+            if (!grown) return false;
+            slot->data     = grown;
+            slot->capacity = capacity;
+        }
+        slot->length += flush_entry_batch(&batch, slot->data + slot->length);
+    }
+    return true;
+}
+
+static void *validation_worker(void *argument) {
+    Parallel_validator *validator = argument;
+    for (;;) {
+        pthread_mutex_lock(&validator->lock);
+        while (!validator->failed && validator->next_chunk < validator->chunk_count &&
+               validator->next_chunk >= validator->written + validator->window) {
+            pthread_cond_wait(&validator->slot_free, &validator->lock);
+        }
+        if (validator->failed || validator->next_chunk >= validator->chunk_count) {
+            pthread_mutex_unlock(&validator->lock);
+            return NULL;
+        }
+        size_t chunk = validator->next_chunk++;
+        pthread_mutex_unlock(&validator->lock);
+
+        Output_slot *slot = &validator->slots[chunk % validator->window];
+        bool validated = validate_chunk(validator, chunk, slot);
+
+        pthread_mutex_lock(&validator->lock);
+        slot->done = true;
+        if (!validated) validator->failed = true;
+        pthread_cond_broadcast(&validator->chunk_done);
+        pthread_mutex_unlock(&validator->lock);
+    }
+}
+
+// Validate the input with thread_count workers, returns 0 like main
+int validate_in_parallel(const char *input_path, FILE *output_file, int thread_count) {
+    int fd = open(input_path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
         printf("Error opening file.\n");
+        if (fd >= 0) close(fd);
         return 1;
     }
+    size_t size  = (size_t)info.st_size;
+    char  *input = NULL;
+    if (size > 0) {
+        input = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (input == MAP_FAILED) {
+            printf("Error opening file.\n");
+            close(fd);
+            return 1;
+        }
+        posix_madvise(input, size, POSIX_MADV_SEQUENTIAL);
+    }
+    close(fd);
 
-    char line[MAX_LINE_LENGTH];
+    Parallel_validator validator;
+    memset(&validator, 0, sizeof(validator));
+    validator.input       = input;
+    validator.size        = size;
+    validator.start       = size > 0 ? next_entry_length(input, size) : 0; // Skip the first line of input file
+    validator.chunk_count = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    validator.window      = 2 * (size_t)thread_count + 2;
+    validator.slots       = calloc(validator.window, sizeof(Output_slot));
+    pthread_mutex_init(&validator.lock, NULL);
+    pthread_cond_init(&validator.chunk_done, NULL);
+    pthread_cond_init(&validator.slot_free, NULL);
 
-    // Skip the first line of input file
-    fgets(line, sizeof(line), input_file);
+    pthread_t *workers = calloc((size_t)thread_count, sizeof(pthread_t));
+    int started = 0;
+    if (validator.slots && workers) {
+        verhoeff_batch_init(); // the workers only read the tables
+        while (started < thread_count && pthread_create(&workers[started], NULL, validation_worker, &validator) == 0) {
+            started++;
+        }
+    }
+    if (started == 0) validator.failed = true;
 
     // Write header to the output file
     fprintf(output_file, "TID   ; SID   ; BID    #This is the output format\n");
 
-    while (fgets(line, sizeof(line), input_file)) {
-        char tid[6], sid[6], bid[6], extra[MAX_LINE_LENGTH];
-
-        // Strict format check: Ensures exactly 3 five-digit numbers with no extra characters
-        if (sscanf(line, " %5[0-9] , %5[0-9] , %5[0-9] %s", tid, sid, bid, extra) != 3) {
-            fprintf(output_file, "INVALID ENTRY\n");
-            continue;
+    for (size_t chunk = 0; chunk < validator.chunk_count; chunk++) {
+        Output_slot *slot = &validator.slots[chunk % validator.window];
+        pthread_mutex_lock(&validator.lock);
+        while (!slot->done && !validator.failed) {
+            pthread_cond_wait(&validator.chunk_done, &validator.lock);
         }
+        bool failed = validator.failed;
+        pthread_mutex_unlock(&validator.lock);
+        if (failed) break;
 
-        int tid_num = atoi(tid);
-        int sid_num = atoi(sid);
-        int bid_num = atoi(bid);
+        if (slot->length > 0) fwrite(slot->data, 1, slot->length, output_file);
 
-        if (!is_valid_id(tid_num) || !is_valid_id(sid_num) || !is_valid_id(bid_num)) {
-            fprintf(output_file, "INVALID ENTRY\n");
-            continue;
+        pthread_mutex_lock(&validator.lock);
+        slot->done = false;
+        validator.written++;
+        pthread_cond_broadcast(&validator.slot_free);
+        pthread_mutex_unlock(&validator.lock);
+    }
+
+    pthread_mutex_lock(&validator.lock);
+    bool failed = validator.failed;
+    validator.failed = true; // stops workers still waiting for a slot
+    pthread_cond_broadcast(&validator.slot_free);
+    pthread_mutex_unlock(&validator.lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    for (size_t i = 0; validator.slots && i < validator.window; i++) {
+        free(validator.slots[i].data);
+    }
+    free(validator.slots);
+    free(workers);
+    pthread_mutex_destroy(&validator.lock);
+    pthread_cond_destroy(&validator.chunk_done);
+    pthread_cond_destroy(&validator.slot_free);
+    if (input) munmap(input, size);
+
+    if (failed) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    // --threads N validates a memory-mapped input.txt with N worker threads (0 means one per core)
+    int thread_count = -1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+            if (thread_count <= 0) {
+                long cores = sysconf(_SC_NPROCESSORS_ONLN);
+                thread_count = cores > 0 ? (int)cores : 1;
+            }
+        } else {
+            printf("Usage: %s [--threads N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (thread_count > 0) {
+        FILE *output_file = fopen("output.txt", "w");
+        if (!output_file) {
+            printf("Error opening file.\n");
+            return 1;
         }
+        setvbuf(output_file, NULL, _IOFBF, OUTPUT_BUFFER);
+        int result = validate_in_parallel("input.txt", output_file, thread_count);
+        fclose(output_file);
+        if (result == 0) printf("Input has been validated. Please check output.txt\n");
+        return result;
+    }
+
+    FILE *input_file = fopen("input.txt", "r");
+    FILE *output_file = fopen("output.txt", "w");
+    if (!input_file || !output_file) {
+        printf("Error opening file.\n");
+        return 1;
+    }
 
-        int tid_check = calculate_check_digit(tid_num);
-        int sid_check = calculate_check_digit(sid_num);
-        int bid_check = calculate_check_digit(bid_num);
+    char  line[MAX_LINE_LENGTH];
+    char *output = malloc(OUTPUT_BUFFER); // entries are formatted here and written a buffer at a time
+    size_t used  = 0;
+    Entry_batch *batch = malloc(sizeof(Entry_batch));
+    if (!output || !batch) {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
 
-        fprintf(output_file, "%05d%d, %05d%d, %05d%d\n", tid_num, tid_check, sid_num, sid_check, bid_num, bid_check);
+    // Skip the first line of input file
+    fgets(line, sizeof(line), input_file);
+
+    // Write header to the output file
+    fprintf(output_file, "TID   ; SID   ; BID    #This is the output format\n");
+
+    batch->count = 0;
+    bool more = true;
+    while (more) {
+        more = fgets(line, sizeof(line), input_file) != NULL;
+        if (more) batch_entry(batch, line, line + strlen(line));
+        if (batch->count == ENTRY_BATCH || (!more && batch->count > 0)) {
+            if (OUTPUT_BUFFER - used < ENTRY_BATCH * MAX_OUTPUT_ENTRY) {
+                fwrite(output, 1, used, output_file);
+                used = 0;
+            }
+            used += flush_entry_batch(batch, output + used);
+        }
     }
+    fwrite(output, 1, used, output_file);
+    free(output);
+    free(batch);
 
     fclose(input_file);
     fclose(output_file);
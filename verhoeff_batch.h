@@ -0,0 +1,167 @@
+#ifndef VERHOEFF_BATCH_H
+#define VERHOEFF_BATCH_H
+
+// Table-driven Verhoeff-Gumm check digits, one ID at a time or whole arrays at once.
+// Shared by project2.c, utility_verhoeff_gumm.c and verhoeffmann-benchmarks.cpp,
+// so it is plain C that also compiles as C++.
+//
+// The check digit of a 5 digit prefix a1 a2 a3 a4 a5 is inv(f(a1, f(a2, f(a3, f(a4, a5)))))
+// with f(a, b) = a * b in the dihedral group D5 (the permutation used by f is the
+// identity). The product is associative, so it splits into the product of the first
+// three digits and the product of the last two, and two small tables replace the
+// five chained lookups:
+//     high[first three digits]            product of a1 a2 a3          (1000 entries)
+//     final[high * 100 + last two digits] inverse of the whole product (1000 entries)
+// The batch functions extract the digits of 8 IDs at once with AVX2 and look both
+// tables up with gathers when the CPU has AVX2, and run the scalar loop otherwise.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VERHOEFF_BATCH_AVX2 1
+#endif
+
+static const int verhoeff_group_table[10][10] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
+    {1, 2, 3, 4, 0, 6, 7, 8, 9, 5},
+    {2, 3, 4, 0, 1, 7, 8, 9, 5, 6},
+    {3, 4, 0, 1, 2, 8, 9, 5, 6, 7},
+    {4, 0, 1, 2, 3, 9, 5, 6, 7, 8},
+    {5, 9, 8, 7, 6, 0, 4, 3, 2, 1},
+    {6, 5, 9, 8, 7, 1, 0, 4, 3, 2},
+    {7, 6, 5, 9, 8, 2, 1, 0, 4, 3},
+    {8, 7, 6, 5, 9, 3, 2, 1, 0, 4},
+    {9, 8, 7, 6, 5, 4, 3, 2, 1, 0}
+};
+static const int verhoeff_inverse_table[10] = {0, 4, 3, 2, 1, 5, 9, 8, 7, 6};
+
+// 3 bytes of padding: a gather reads 4 bytes from the byte offset of an entry
+static uint8_t verhoeff_high_table[1000 + 3];
+static uint8_t verhoeff_final_table[1000 + 3];
+static bool    verhoeff_tables_ready = false;
+
+// Fill the tables. With GCC and Clang this runs as a constructor before main, when no
+// other thread can exist yet, so every function below only ever reads the tables and
+// may be called from any number of threads. Every function below still calls it: with
+// other compilers the tables are filled on first use, and a program there must call
+// it once before it starts threads that use the functions below.
+#if defined(__GNUC__)
+__attribute__((constructor))
+#endif
+static inline void verhoeff_batch_init(void) {
+    if (verhoeff_tables_ready) return;
+    for (int digits = 0; digits < 1000; digits++) {
+        int a1 = digits / 100, a2 = digits / 10 % 10, a3 = digits % 10;
+        verhoeff_high_table[digits] = (uint8_t)verhoeff_group_table[verhoeff_group_table[a1][a2]][a3];
+    }
+    for (int high = 0; high < 10; high++) {
+        for (int low = 0; low < 100; low++) {
+            int product = verhoeff_group_table[high][verhoeff_group_table[low / 10][low % 10]];
+            verhoeff_final_table[high * 100 + low] = (uint8_t)verhoeff_inverse_table[product];
+        }
+    }
+    verhoeff_tables_ready = true;
+}
+
+// Check digit of a prefix of 5 digits (0..99999, leading zeros count as digits), -1 for anything else
+static inline int verhoeff_check_digit(int32_t prefix) {
+    verhoeff_batch_init();
+    if (prefix < 0 || prefix > 99999) return -1;
+    return verhoeff_final_table[verhoeff_high_table[prefix / 100] * 100 + prefix % 100];
+}
+
+// True for a 6 digit ID (100000..999999) whose last digit is the check digit of the others
+static inline bool verhoeff_is_valid(int32_t id) {
+    if (id < 100000 || id > 999999) return false;
+    return verhoeff_check_digit(id / 10) == id % 10;
+}
+
+#ifdef VERHOEFF_BATCH_AVX2
+// Check digits of 8 prefixes that are known to be in 0..99999
+__attribute__((target("avx2")))
+static inline __m256i verhoeff_check_digits8_avx2(__m256i prefix) {
+    // float division is exact enough: the quotient is never within one ulp of the next integer
+    __m256i high = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(prefix), _mm256_set1_ps(100.0f)));
+    __m256i low  = _mm256_sub_epi32(prefix, _mm256_mullo_epi32(high, _mm256_set1_epi32(100)));
+    __m256i mask = _mm256_set1_epi32(0xFF);
+    __m256i product = _mm256_and_si256(
+        _mm256_i32gather_epi32((const int*)(const void*)verhoeff_high_table, high, 1), mask);
+    __m256i entry = _mm256_add_epi32(_mm256_mullo_epi32(product, _mm256_set1_epi32(100)), low);
+    return _mm256_and_si256(_mm256_i32gather_epi32((const int*)(const void*)verhoeff_final_table, entry, 1), mask);
+}
+
+__attribute__((target("avx2")))
+static inline size_t verhoeff_check_digits_avx2(const int32_t *prefixes, int8_t *checks, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i prefix   = _mm256_loadu_si256((const __m256i*)(const void*)(prefixes + i));
+        __m256i in_range = _mm256_and_si256(_mm256_cmpgt_epi32(prefix, _mm256_set1_epi32(-1)),
+                                            _mm256_cmpgt_epi32(_mm256_set1_epi32(100000), prefix));
+        __m256i check    = verhoeff_check_digits8_avx2(_mm256_and_si256(prefix, in_range));
+        check = _mm256_or_si256(_mm256_and_si256(in_range, check), _mm256_andnot_si256(in_range, _mm256_set1_epi32(-1)));
+        int32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)(void*)lanes, check);
+        for (int lane = 0; lane < 8; lane++) checks[i + lane] = (int8_t)lanes[lane];
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline size_t verhoeff_validate_avx2(const int32_t *ids, uint8_t *valid, size_t count, size_t *valid_count) {
+    size_t i = 0, found = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i id       = _mm256_loadu_si256((const __m256i*)(const void*)(ids + i));
+        __m256i in_range = _mm256_and_si256(_mm256_cmpgt_epi32(id, _mm256_set1_epi32(99999)),
+                                            _mm256_cmpgt_epi32(_mm256_set1_epi32(1000000), id));
+        id = _mm256_and_si256(id, in_range); // out of range IDs are looked up as 0 and masked below
+        __m256i prefix = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(id), _mm256_set1_ps(10.0f)));
+        __m256i digit  = _mm256_sub_epi32(id, _mm256_mullo_epi32(prefix, _mm256_set1_epi32(10)));
+        __m256i match  = _mm256_and_si256(in_range, _mm256_cmpeq_epi32(verhoeff_check_digits8_avx2(prefix), digit));
+        unsigned bits  = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(match));
+        for (int lane = 0; lane < 8; lane++) valid[i + lane] = (uint8_t)((bits >> lane) & 1);
+        found += (size_t)__builtin_popcount(bits);
+    }
+    *valid_count = found;
+    return i;
+}
+
+static inline bool verhoeff_batch_has_avx2(void) {
+    static int supported = -1;
+    if (supported < 0) {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return supported == 1;
+}
+#endif
+
+// checks[i] = verhoeff_check_digit(prefixes[i]) for every i below count
+static inline void verhoeff_check_digits_batch(const int32_t *prefixes, int8_t *checks, size_t count) {
+    verhoeff_batch_init();
+    size_t i = 0;
+#ifdef VERHOEFF_BATCH_AVX2
+    if (verhoeff_batch_has_avx2()) i = verhoeff_check_digits_avx2(prefixes, checks, count);
+#endif
+    for (; i < count; i++) {
+        checks[i] = (int8_t)verhoeff_check_digit(prefixes[i]);
+    }
+}
+
+// valid[i] = verhoeff_is_valid(ids[i]) for every i below count, returns how many are valid
+static inline size_t verhoeff_validate_batch(const int32_t *ids, uint8_t *valid, size_t count) {
+    verhoeff_batch_init();
+    size_t i = 0, found = 0;
+#ifdef VERHOEFF_BATCH_AVX2
+    if (verhoeff_batch_has_avx2()) i = verhoeff_validate_avx2(ids, valid, count, &found);
+#endif
+    for (; i < count; i++) {
+        valid[i] = verhoeff_is_valid(ids[i]);
+        found += valid[i];
+    }
+    return found;
+}
+
+#endif
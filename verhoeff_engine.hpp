@@ -0,0 +1,164 @@
+#ifndef VERHOEFF_ENGINE_HPP
+#define VERHOEFF_ENGINE_HPP
+
+// Compile-time Verhoeff engine for IDs of any width up to 18 digits plus a check digit.
+//
+// Verhoeff_engine<Digits> is the full Verhoeff scheme: digit i (counted from the right,
+// the check digit being digit 0) goes through the permutation p^(i mod 8) before it is
+// multiplied into the D5 product, which is what catches adjacent transpositions.
+// Verhoeff_engine<Digits, Verhoeff_scheme::plain_product> is the scheme the rest of
+// the repo uses today (the product a1 * a2 * ... * an, no permutation, and the repo's
+// own inverse table), so Verhoeff_engine<5, Verhoeff_scheme::plain_product> matches
+// calculate_check_digit.
+//
+// All tables are built by constexpr functions. Digits are consumed two at a time,
+// a 10 x 100 table per pair of positions folds both multiplications into one
+// lookup, and the loop over the pairs is unrolled for each width.
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+enum class Verhoeff_scheme { positional, plain_product };
+
+namespace verhoeff_detail {
+
+using Table = std::array<std::array<std::uint8_t, 10>, 10>;
+using Pair_table = std::array<std::array<std::uint8_t, 100>, 10>;
+
+// D5: rotations 0..4, reflections 5..9
+constexpr Table make_multiplication() {
+    Table d{};
+    for (int i = 0; i < 10; i++) {
+        for (int j = 0; j < 10; j++) {
+            int value = 0;
+            if (i < 5 && j < 5)  value = (i + j) % 5;
+            else if (i < 5)      value = 5 + (i + j) % 5;
+            else if (j < 5)      value = 5 + (i - j + 5) % 5;
+            else                 value = (i - j + 5) % 5;
+            d[i][j] = static_cast<std::uint8_t>(value);
+        }
+    }
+    return d;
+}
+
+// p^0 is the identity, p^(i+1)(x) = p^i(p(x)) with p = (0 1 5 8 9 4 2 7)(3 6)
+constexpr std::array<std::array<std::uint8_t, 10>, 8> make_permutations() {
+    constexpr std::uint8_t p[10] = {1, 5, 7, 6, 2, 8, 3, 0, 9, 4};
+    std::array<std::array<std::uint8_t, 10>, 8> permutation{};
+    for (int x = 0; x < 10; x++) permutation[0][x] = static_cast<std::uint8_t>(x);
+    for (int i = 1; i < 8; i++) {
+        for (int x = 0; x < 10; x++) permutation[i][x] = permutation[i - 1][p[x]];
+    }
+    return permutation;
+}
+
+constexpr std::array<std::uint8_t, 10> make_inverse(const Table &d) {
+    std::array<std::uint8_t, 10> inverse{};
+    for (int x = 0; x < 10; x++) {
+        for (int y = 0; y < 10; y++) {
+            if (d[x][y] == 0) inverse[x] = static_cast<std::uint8_t>(y);
+        }
+    }
+    return inverse;
+}
+
+constexpr Table multiplication = make_multiplication();
+constexpr auto  permutation    = make_permutations();
+constexpr auto  inverse        = make_inverse(multiplication);
+
+// inv_table of the existing code: rotations get their inverse, but the reflections
+// 6..9 map to 9..6 rather than to themselves. Existing IDs were issued with it.
+constexpr std::array<std::uint8_t, 10> plain_product_inverse = {0, 4, 3, 2, 1, 5, 9, 8, 7, 6};
+
+// positional: state after the digits at positions i (low) and i + 1 (high) of the
+// two digit value v = high * 10 + low, for each of the four odd starting positions
+constexpr std::array<Pair_table, 4> make_positional_pairs() {
+    std::array<Pair_table, 4> pairs{};
+    for (int k = 0; k < 4; k++) {
+        int position = 2 * k + 1;
+        for (int c = 0; c < 10; c++) {
+            for (int v = 0; v < 100; v++) {
+                int state = multiplication[c][permutation[position % 8][v % 10]];
+                pairs[k][c][v] = multiplication[state][permutation[(position + 1) % 8][v / 10]];
+            }
+        }
+    }
+    return pairs;
+}
+
+// plain product, read right to left: state = (high * low) * state
+constexpr Pair_table make_product_pairs() {
+    Pair_table pairs{};
+    for (int c = 0; c < 10; c++) {
+        for (int v = 0; v < 100; v++) {
+            pairs[c][v] = multiplication[multiplication[v / 10][v % 10]][c];
+        }
+    }
+    return pairs;
+}
+
+constexpr auto positional_pairs = make_positional_pairs();
+constexpr auto product_pairs    = make_product_pairs();
+
+constexpr std::uint64_t power_of_ten(unsigned n) {
+    std::uint64_t value = 1;
+    while (n--) value *= 10;
+    return value;
+}
+
+} // namespace verhoeff_detail
+
+template <unsigned Digits, Verhoeff_scheme Scheme = Verhoeff_scheme::positional>
+struct Verhoeff_engine {
+    static_assert(Digits >= 1 && Digits <= 18, "an ID has 1 to 18 digits before its check digit");
+
+    static constexpr std::uint64_t prefix_limit = verhoeff_detail::power_of_ten(Digits);     // prefixes are below this
+    static constexpr std::uint64_t id_limit     = verhoeff_detail::power_of_ten(Digits + 1); // whole IDs are below this
+
+    // Check digit of a prefix of Digits digits (leading zeros count as digits), -1 if it is wider
+    static constexpr int check_digit(std::uint64_t prefix) {
+        if (prefix >= prefix_limit) return -1;
+        unsigned state = product(prefix, std::make_index_sequence<Digits / 2>{});
+        if constexpr (Scheme == Verhoeff_scheme::positional) {
+            return verhoeff_detail::inverse[state];
+        } else {
+            return verhoeff_detail::plain_product_inverse[state];
+        }
+    }
+
+    // True when the last digit of id is the check digit of the Digits digits before it
+    static constexpr bool is_valid(std::uint64_t id) {
+        if (id >= id_limit) return false;
+        return check_digit(id / 10) == static_cast<int>(id % 10);
+    }
+
+private:
+    template <std::size_t Pair>
+    static constexpr void multiply_pair(std::uint64_t &prefix, unsigned &state) {
+        unsigned v = static_cast<unsigned>(prefix % 100);
+        prefix /= 100;
+        if constexpr (Scheme == Verhoeff_scheme::positional) {
+            state = verhoeff_detail::positional_pairs[Pair % 4][state][v]; // positions 2 * Pair + 1 and 2 * Pair + 2
+        } else {
+            state = verhoeff_detail::product_pairs[state][v];
+        }
+    }
+
+    template <std::size_t... Pairs>
+    static constexpr unsigned product(std::uint64_t prefix, std::index_sequence<Pairs...>) {
+        unsigned state = 0;
+        (multiply_pair<Pairs>(prefix, state), ...);
+        if constexpr (Digits % 2 == 1) { // the leading digit has no partner
+            unsigned digit = static_cast<unsigned>(prefix);
+            if constexpr (Scheme == Verhoeff_scheme::positional) {
+                state = verhoeff_detail::multiplication[state][verhoeff_detail::permutation[Digits % 8][digit]];
+            } else {
+                state = verhoeff_detail::multiplication[digit][state];
+            }
+        }
+        return state;
+    }
+};
+
+#endif
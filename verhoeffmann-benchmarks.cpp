@@ -7,81 +7,46 @@
 #include <iomanip>
 #include <random>    // For std::random_device, std::mt19937, std::uniform_int_distribution
 #include <algorithm> // For std::shuffle
+#include <atomic>
+#include <thread>
+#include <array>
+#include <fstream>
+#include <chrono>
+#include "verhoeff_batch.h"
+#include "verhoeff_engine.hpp"
 
-// --- Verhoeff-Gumm Tables (Copied from your C code) ---
-// Dihedral permutation table
-static const int permutation_table[8][10] = {
-    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
-    {1, 5, 7, 6, 2, 8, 3, 0, 9, 4},
-    {5, 8, 0, 3, 7, 9, 6, 1, 4, 2},
-    {8, 9, 1, 6, 0, 4, 3, 5, 2, 7},
-    {9, 4, 5, 3, 1, 2, 6, 8, 7, 0},
-    {4, 2, 8, 6, 5, 7, 3, 9, 0, 1},
-    {2, 7, 9, 3, 8, 0, 6, 4, 1, 5},
-    {7, 0, 4, 6, 9, 1, 3, 2, 5, 8}
-};
-
-// Non-commutative multiplication table (D5 group)
-static const int d5_mult_table[10][10] = {
-    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
-    {1, 2, 3, 4, 0, 6, 7, 8, 9, 5},
-    {2, 3, 4, 0, 1, 7, 8, 9, 5, 6},
-    {3, 4, 0, 1, 2, 8, 9, 5, 6, 7},
-    {4, 0, 1, 2, 3, 9, 5, 6, 7, 8},
-    {5, 9, 8, 7, 6, 0, 4, 3, 2, 1},
-    {6, 5, 9, 8, 7, 1, 0, 4, 3, 2},
-    {7, 6, 5, 9, 8, 2, 1, 0, 4, 3},
-    {8, 7, 6, 5, 9, 3, 2, 1, 0, 4},
-    {9, 8, 7, 6, 5, 4, 3, 2, 1, 0}
-};
-
-// Inverse lookup table
-static const int inv_table[10] = {0, 4, 3, 2, 1, 5, 9, 8, 7, 6};
-
-// Implementation of f(a,b) for Verhoeff-Gumm
-static int verhoeff_f(int a, int b) {
-    return d5_mult_table[a][permutation_table[0][b]];
-}
+// --- Verhoeff-Gumm (table-driven, shared with the C code in verhoeff_batch.h) ---
 
 // Verhoeff-Gumm check digit calculation for a 5-digit number
 int calculate_verhoeff_check_digit(int five_digit_number) {
-    if (five_digit_number < 0 || five_digit_number > 99999) {
-        // Should not happen with controlled input for this benchmark
-        return -1;
-    }
-
-    int a1 = (five_digit_number / 10000) % 10;
-    int a2 = (five_digit_number / 1000) % 10;
-    int a3 = (five_digit_number / 100) % 10;
-    int a4 = (five_digit_number / 10) % 10;
-    int a5 = five_digit_number % 10;
-
-    // Calculate c = f(a1, f(a2, f(a3, f(a4, a5))))
-    int c = verhoeff_f(a1, verhoeff_f(a2, verhoeff_f(a3, verhoeff_f(a4, a5))));
-
-    // Return inverse of c
-    return inv_table[c];
+    // -1 outside 0..99999, which should not happen with controlled input for this benchmark
+    return verhoeff_check_digit(five_digit_number);
 }
 
 // --- Your Other Algorithms ---
 
-// Helper to get digits from a number
-std::vector<int> get_digits(int number, int num_digits) {
-    std::string s = std::to_string(number);
-    // Pad with leading zeros if necessary
-    while (s.length() < num_digits) {
-        s = "0" + s;
+// Helper to get the digits of a number into a stack array, most significant first
+// and padded with leading zeros (num_digits must cover the whole number)
+inline void get_digits(int number, int num_digits, int digits[]) {
+    for (int i = num_digits - 1; i >= 0; --i) {
+        digits[i] = number % 10;
+        number /= 10;
     }
-    std::vector<int> digits;
-    for (char c : s) {
-        digits.push_back(c - '0');
+}
+
+// Helper to put digits back together into a number
+inline int from_digits(const int digits[], int num_digits) {
+    int number = 0;
+    for (int i = 0; i < num_digits; ++i) {
+        number = number * 10 + digits[i];
     }
-    return digits;
+    return number;
 }
 
 // Algorithm 1: Sum of first five digits % 10
 int calculate_algo1_check_digit(int five_digit_number) {
-    std::vector<int> digits = get_digits(five_digit_number, 5);
+    int digits[5];
+    get_digits(five_digit_number, 5, digits);
     int sum = 0;
     for (int digit : digits) {
         sum += digit;
@@ -91,7 +56,8 @@ int calculate_algo1_check_digit(int five_digit_number) {
 
 // Algorithm 2: Sum of squares of first five digits % 10
 int calculate_algo2_check_digit(int five_digit_number) {
-    std::vector<int> digits = get_digits(five_digit_number, 5);
+    int digits[5];
+    get_digits(five_digit_number, 5, digits);
     int sum_sq = 0;
     for (int digit : digits) {
         sum_sq += digit * digit;
@@ -101,8 +67,8 @@ int calculate_algo2_check_digit(int five_digit_number) {
 
 // Algorithm 3: f = (a*b + b*c + c*d + d*e + e*a) % 10
 int calculate_algo3_check_digit(int five_digit_number) {
-    std::vector<int> digits = get_digits(five_digit_number, 5);
-    if (digits.size() < 5) return -1; // Should not happen with valid input range
+    int digits[5];
+    get_digits(five_digit_number, 5, digits);
 
     int a = digits[0];
     int b = digits[1];
@@ -115,8 +81,8 @@ int calculate_algo3_check_digit(int five_digit_number) {
 
 // Algorithm 4: f = (a*b*c + b*c*d + c*d*e + d*e*a + e*a*b) % 10
 int calculate_algo4_check_digit(int five_digit_number) {
-    std::vector<int> digits = get_digits(five_digit_number, 5);
-    if (digits.size() < 5) return -1; // Should not happen with valid input range
+    int digits[5];
+    get_digits(five_digit_number, 5, digits);
 
     int a = digits[0];
     int b = digits[1];
@@ -130,13 +96,14 @@ int calculate_algo4_check_digit(int five_digit_number) {
 // --- Luhn Algorithm ---
 // Luhn Algorithm Check Digit Calculation for a 5-digit number
 int calculate_luhn_check_digit(int five_digit_number) {
-    std::vector<int> digits = get_digits(five_digit_number, 5);
+    int digits[5];
+    get_digits(five_digit_number, 5, digits);
 
     int sum = 0;
     bool double_digit = true; // Start doubling from the rightmost digit of the 5-digit number
 
     // Process from right to left (simulating the way Luhn processes full number)
-    for (int i = digits.size() - 1; i >= 0; --i) {
+    for (int i = 4; i >= 0; --i) {
         int digit = digits[i];
         if (double_digit) {
             digit *= 2;
@@ -154,12 +121,13 @@ int calculate_luhn_check_digit(int five_digit_number) {
 
 // Validation for Luhn
 bool is_valid_luhn(int six_digit_number) {
-    std::vector<int> digits = get_digits(six_digit_number, 6);
+    int digits[6];
+    get_digits(six_digit_number, 6, digits);
 
     int sum = 0;
     bool double_digit = false; // For full number, start doubling from the second to last digit
 
-    for (int i = digits.size() - 1; i >= 0; --i) {
+    for (int i = 5; i >= 0; --i) {
         int digit = digits[i];
         if (double_digit) {
             digit *= 2;
@@ -174,24 +142,25 @@ bool is_valid_luhn(int six_digit_number) {
 }
 
 // --- Damm Algorithm ---
-// Example Damm Quasigroup Table
+// Damm's weakly totally anti-symmetric quasigroup of order 10 (zero diagonal)
 static const int damm_table[10][10] = {
     {0, 3, 1, 7, 5, 9, 8, 6, 4, 2},
     {7, 0, 9, 2, 1, 5, 4, 8, 6, 3},
-    {4, 2, 0, 6, 8, 7, 3, 9, 1, 5},
+    {4, 2, 0, 6, 8, 7, 1, 3, 5, 9},
     {1, 7, 5, 0, 9, 8, 3, 4, 2, 6},
-    {6, 1, 2, 3, 0, 4, 5, 7, 9, 8},
-    {3, 6, 4, 9, 7, 0, 2, 5, 8, 1},
-    {5, 8, 6, 4, 2, 1, 0, 3, 7, 9},
-    {8, 9, 3, 1, 4, 2, 7, 0, 5, 6},
-    {9, 4, 7, 8, 3, 6, 1, 0, 2, 5},
-    {2, 5, 8, 0, 6, 3, 4, 1, 9, 7}
+    {6, 1, 2, 3, 0, 4, 5, 9, 7, 8},
+    {3, 6, 7, 4, 2, 0, 9, 5, 8, 1},
+    {5, 8, 6, 9, 7, 2, 0, 1, 3, 4},
+    {8, 9, 4, 5, 3, 6, 2, 0, 1, 7},
+    {9, 4, 3, 8, 6, 1, 7, 2, 0, 5},
+    {2, 5, 8, 1, 4, 3, 6, 7, 9, 0}
 };
 
 // Damm Algorithm Check Digit Calculation for a 5-digit number
 int calculate_damm_check_digit(int five_digit_number) {
-    std::vector<int> digits = get_digits(five_digit_number, 5);
-    
+    int digits[5];
+    get_digits(five_digit_number, 5, digits);
+
     int interim_digit = 0;
     for (int digit : digits) {
         interim_digit = damm_table[interim_digit][digit];
@@ -201,7 +170,8 @@ int calculate_damm_check_digit(int five_digit_number) {
 
 // Validation for Damm
 bool is_valid_damm(int six_digit_number) {
-    std::vector<int> digits = get_digits(six_digit_number, 6);
+    int digits[6];
+    get_digits(six_digit_number, 6, digits);
 
     int interim_digit = 0;
     for (int digit : digits) {
@@ -220,6 +190,11 @@ bool is_valid_verhoeff(int six_digit_number) {
     return calculate_verhoeff_check_digit(five_digit_prefix) == actual_check_digit;
 }
 
+// Checks if a 6-digit number is valid according to the positional Verhoeff scheme
+bool is_valid_verhoeff_positional(int six_digit_number) {
+    return Verhoeff_engine<5>::is_valid(static_cast<std::uint64_t>(six_digit_number));
+}
+
 // Checks if a 6-digit number is valid according to Algorithm 1
 bool is_valid_algo1(int six_digit_number) {
     int five_digit_prefix = six_digit_number / 10;
@@ -252,173 +227,524 @@ bool is_valid_algo4(int six_digit_number) {
 
 // Introduces a single-digit substitution error
 int introduce_substitution_error(int number, std::mt19937& gen, std::uniform_int_distribution<int>& dist_pos, std::uniform_int_distribution<int>& dist_digit) {
-    std::string s = std::to_string(number);
-    while (s.length() < 6) { // Ensure it's always 6 digits, e.g., 098765
-        s = "0" + s;
-    }
+    int digits[6];
+    get_digits(number, 6, digits); // Always 6 digits, e.g., 098765
     int pos = dist_pos(gen); // Random position to change (0 to 5)
-    int original_digit = s[pos] - '0';
+    int original_digit = digits[pos];
     int new_digit;
     do {
         new_digit = dist_digit(gen); // Random new digit (0 to 9)
     } while (new_digit == original_digit); // Ensure it's a different digit
 
-    s[pos] = (char)('0' + new_digit);
-    return std::stoi(s);
+    digits[pos] = new_digit;
+    return from_digits(digits, 6);
 }
 
 // Introduces an adjacent transposition error
 int introduce_transposition_error(int number, std::mt19937& gen, std::uniform_int_distribution<int>& dist_trans_pos) {
-    std::string s = std::to_string(number);
-    while (s.length() < 6) {
-        s = "0" + s;
-    }
-    if (s.length() < 2) return number; // Cannot transpose if less than 2 digits
+    int digits[6];
+    get_digits(number, 6, digits);
 
-    int pos = dist_trans_pos(gen); // Random starting position for transposition (0 to length-2)
-    std::swap(s[pos], s[pos + 1]);
-    return std::stoi(s);
+    int pos = dist_trans_pos(gen); // Random starting position for transposition (0 to 4)
+    std::swap(digits[pos], digits[pos + 1]);
+    return from_digits(digits, 6);
 }
 
 
-int main() {
-    std::cout << "Benchmarking check digit algorithms for error detection...\n";
-
-    // Random number generation setup
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dist_six_digit_prefix(10000, 99999); // For first five digits
-    std::uniform_int_distribution<> dist_pos(0, 5); // For substitution error position (0-indexed for 6 digits)
-    std::uniform_int_distribution<> dist_digit(0, 9); // For new digit in substitution
-    std::uniform_int_distribution<> dist_trans_pos(0, 4); // For transposition error position (0 to 4 for a 6-digit number)
+// --- Throughput Kernels ---
 
-    const int NUM_VALID_NUMBERS_TO_GENERATE = 10000; // Number of unique valid numbers to test
-    const int NUM_ERRORS_PER_VALID_NUMBER = 50; // Number of errors to introduce for each valid number
-
-    long long total_substitution_errors = 0;
-    long long total_transposition_errors = 0;
+// Time one pass of generating (or validating) every number, the sum keeps the
+// compiler from dropping the calls. The functions are template arguments so that
+// they are inlined into the loop just as they would be in real code.
+template <int (*CheckDigit)(int)>
+double time_generate_pass(const std::vector<int> &prefixes, long long &sink) {
+    auto start = std::chrono::steady_clock::now();
+    long long sum = 0;
+    for (int prefix : prefixes) {
+        sum += CheckDigit(prefix);
+    }
+    auto end = std::chrono::steady_clock::now();
+    sink += sum;
+    return std::chrono::duration<double, std::nano>(end - start).count() / prefixes.size();
+}
 
-    long long verhoeff_undetected_substitutions = 0;
-    long long algo1_undetected_substitutions = 0;
-    long long algo2_undetected_substitutions = 0;
-    long long algo3_undetected_substitutions = 0;
-    long long algo4_undetected_substitutions = 0;
+template <bool (*IsValid)(int)>
+double time_validate_pass(const std::vector<int> &numbers, long long &sink) {
+    auto start = std::chrono::steady_clock::now();
+    long long valid = 0;
+    for (int number : numbers) {
+        valid += IsValid(number);
+    }
+    auto end = std::chrono::steady_clock::now();
+    sink += valid;
+    return std::chrono::duration<double, std::nano>(end - start).count() / numbers.size();
+}
 
+struct Throughput_result {
+    double generate_median, generate_best;  // ns per check digit
+    double validate_median, validate_best;  // ns per validated number
+};
 
-    long long verhoeff_undetected_transpositions = 0;
-    long long algo1_undetected_transpositions = 0;
-    long long algo2_undetected_transpositions = 0;
-    long long algo3_undetected_transpositions = 0;
-    long long algo4_undetected_transpositions = 0;
+// One warm-up pass, then `repetitions` timed passes over every prefix in the shuffled
+// order; half of the validated numbers carry a wrong check digit
+template <int (*CheckDigit)(int), bool (*IsValid)(int)>
+Throughput_result measure_throughput(const std::vector<int> &prefixes, int repetitions, long long &sink) {
+    std::vector<int> numbers;
+    numbers.reserve(prefixes.size());
+    for (size_t i = 0; i < prefixes.size(); ++i) {
+        int check_digit = CheckDigit(prefixes[i]);
+        numbers.push_back(prefixes[i] * 10 + (i % 2 == 0 ? check_digit : (check_digit + 1) % 10));
+    }
 
+    time_generate_pass<CheckDigit>(prefixes, sink);
+    time_validate_pass<IsValid>(numbers, sink);
+    std::vector<double> generate, validate;
+    for (int r = 0; r < repetitions; ++r) {
+        generate.push_back(time_generate_pass<CheckDigit>(prefixes, sink));
+        validate.push_back(time_validate_pass<IsValid>(numbers, sink));
+    }
+    std::sort(generate.begin(), generate.end());
+    std::sort(validate.begin(), validate.end());
+    return {generate[generate.size() / 2], generate.front(), validate[validate.size() / 2], validate.front()};
+}
 
+// --- Detection Runner ---
 
-    // To store unique valid prefixes to avoid duplicate testing and ensure randomization
-    std::vector<int> valid_prefixes;
-    for (int i = 10000; i <= 99999; ++i) {
-        valid_prefixes.push_back(i);
-    }
-    std::shuffle(valid_prefixes.begin(), valid_prefixes.end(), gen); // Shuffle to pick random prefixes
+int calculate_verhoeff_positional_check_digit(int five_digit_prefix) {
+    return Verhoeff_engine<5>::check_digit(static_cast<std::uint64_t>(five_digit_prefix));
+}
 
-    std::cout << "Generating " << NUM_VALID_NUMBERS_TO_GENERATE << " valid numbers and introducing "
-              << NUM_ERRORS_PER_VALID_NUMBER << " errors for each...\n";
+// The algorithms of every table, in the order they are printed
+struct Detection_algorithm {
+    const char *name;
+    int (*check_digit)(int five_digit_prefix);
+    bool (*is_valid)(int six_digit_number);
+    Throughput_result (*measure)(const std::vector<int> &prefixes, int repetitions, long long &sink);
+};
 
-    for (int k = 0; k < NUM_VALID_NUMBERS_TO_GENERATE; ++k) {
-        if (k % 1000 == 0) {
-            std::cout << "Processing batch " << k / 1000 + 1 << "...\n";
+#define DETECTION_ALGORITHM(name, check_digit, is_valid) \
+    {name, check_digit, is_valid, measure_throughput<check_digit, is_valid>}
+
+static const Detection_algorithm detection_algorithms[] = {
+    DETECTION_ALGORITHM("Verhoeff-Gumm",                 calculate_verhoeff_check_digit,            is_valid_verhoeff),
+    DETECTION_ALGORITHM("Verhoeff (positional)",         calculate_verhoeff_positional_check_digit, is_valid_verhoeff_positional),
+    DETECTION_ALGORITHM("Damm",                          calculate_damm_check_digit,                is_valid_damm),
+    DETECTION_ALGORITHM("Luhn",                          calculate_luhn_check_digit,                is_valid_luhn),
+    DETECTION_ALGORITHM("Algorithm 1 (Sum)",             calculate_algo1_check_digit,               is_valid_algo1),
+    DETECTION_ALGORITHM("Algorithm 2 (Sum of Squares)",  calculate_algo2_check_digit,               is_valid_algo2),
+    DETECTION_ALGORITHM("Algorithm 3 (Paired Products)", calculate_algo3_check_digit,               is_valid_algo3),
+    DETECTION_ALGORITHM("Algorithm 4 (Triple Products)", calculate_algo4_check_digit,               is_valid_algo4),
+};
+#undef DETECTION_ALGORITHM
+static const int DETECTION_ALGORITHM_COUNT = sizeof(detection_algorithms) / sizeof(detection_algorithms[0]);
+
+// Undetected errors per algorithm, one per worker and merged at the end
+struct Detection_counts {
+    long long substitutions = 0;
+    long long transpositions = 0;
+    std::vector<long long> undetected_substitutions = std::vector<long long>(DETECTION_ALGORITHM_COUNT, 0);
+    std::vector<long long> undetected_transpositions = std::vector<long long>(DETECTION_ALGORITHM_COUNT, 0);
+
+    void merge(const Detection_counts &other) {
+        substitutions += other.substitutions;
+        transpositions += other.transpositions;
+        for (int a = 0; a < DETECTION_ALGORITHM_COUNT; ++a) {
+            undetected_substitutions[a] += other.undetected_substitutions[a];
+            undetected_transpositions[a] += other.undetected_transpositions[a];
         }
+    }
+};
 
-        int five_digit_prefix = valid_prefixes[k];
+struct Detection_run {
+    std::uint64_t seed = 0;
+    int threads = 1;
+    long long valid_numbers = 10000;     // Number of valid numbers to test
+    int errors_per_number = 50;          // Number of errors to introduce for each valid number
+    std::vector<int> prefixes;           // every 5-digit prefix, shuffled with the seed
+};
 
-        // --- Generate valid numbers for each algorithm ---
-        int valid_verhoeff_num = five_digit_prefix * 10 + calculate_verhoeff_check_digit(five_digit_prefix);
-        int valid_algo1_num = five_digit_prefix * 10 + calculate_algo1_check_digit(five_digit_prefix);
-        int valid_algo2_num = five_digit_prefix * 10 + calculate_algo2_check_digit(five_digit_prefix);
-        int valid_algo3_num = five_digit_prefix * 10 + calculate_algo3_check_digit(five_digit_prefix);
-        int valid_algo4_num = five_digit_prefix * 10 + calculate_algo4_check_digit(five_digit_prefix);
-        int valid_luhn_num = five_digit_prefix * 10 + calculate_luhn_check_digit(five_digit_prefix); // Added Luhn
-        int valid_damm_num = five_digit_prefix * 10 + calculate_damm_check_digit(five_digit_prefix); // Added Damm
+// Valid numbers are handed out in blocks of this many, each with its own RNG stream
+static const long long DETECTION_BLOCK_SIZE = 1000;
 
+// Introduce errors into the valid numbers of one block. The block's generator is
+// seeded from the run seed and the block index alone, so a block gives the same
+// errors whichever worker runs it and however many workers there are.
+void run_detection_block(const Detection_run &run, long long block, Detection_counts &counts) {
+    std::seed_seq seeds{static_cast<std::uint32_t>(run.seed), static_cast<std::uint32_t>(run.seed >> 32),
+                        static_cast<std::uint32_t>(block), static_cast<std::uint32_t>(block >> 32)};
+    std::mt19937 gen(seeds);
+    std::uniform_int_distribution<> dist_pos(0, 5); // For substitution error position (0-indexed for 6 digits)
+    std::uniform_int_distribution<> dist_digit(0, 9); // For new digit in substitution
+    std::uniform_int_distribution<> dist_trans_pos(0, 4); // For transposition error position (0 to 4 for a 6-digit number)
 
-        for (int j = 0; j < NUM_ERRORS_PER_VALID_NUMBER; ++j) {
-            // Test Substitution Errors
-            int erroneous_verhoeff_sub = introduce_substitution_error(valid_verhoeff_num, gen, dist_pos, dist_digit);
-            if (is_valid_verhoeff(erroneous_verhoeff_sub)) {
-                verhoeff_undetected_substitutions++;
+    long long first = block * DETECTION_BLOCK_SIZE;
+    long long last = std::min(first + DETECTION_BLOCK_SIZE, run.valid_numbers);
+    for (long long k = first; k < last; ++k) {
+        // every prefix once before any prefix twice
+        int five_digit_prefix = run.prefixes[k % run.prefixes.size()];
+
+        for (int a = 0; a < DETECTION_ALGORITHM_COUNT; ++a) {
+            const Detection_algorithm &algorithm = detection_algorithms[a];
+            int valid_number = five_digit_prefix * 10 + algorithm.check_digit(five_digit_prefix);
+            for (int j = 0; j < run.errors_per_number; ++j) {
+                // Test Substitution Errors
+                if (algorithm.is_valid(introduce_substitution_error(valid_number, gen, dist_pos, dist_digit))) {
+                    counts.undetected_substitutions[a]++;
+                }
+                // Test Transposition Errors
+                if (algorithm.is_valid(introduce_transposition_error(valid_number, gen, dist_trans_pos))) {
+                    counts.undetected_transpositions[a]++;
+                }
             }
-            int erroneous_algo1_sub = introduce_substitution_error(valid_algo1_num, gen, dist_pos, dist_digit);
-            if (is_valid_algo1(erroneous_algo1_sub)) {
-                algo1_undetected_substitutions++;
-            }
-            int erroneous_algo2_sub = introduce_substitution_error(valid_algo2_num, gen, dist_pos, dist_digit);
-            if (is_valid_algo2(erroneous_algo2_sub)) {
-                algo2_undetected_substitutions++;
-            }
-            int erroneous_algo3_sub = introduce_substitution_error(valid_algo3_num, gen, dist_pos, dist_digit);
-            if (is_valid_algo3(erroneous_algo3_sub)) {
-                algo3_undetected_substitutions++;
-            }
-            int erroneous_algo4_sub = introduce_substitution_error(valid_algo4_num, gen, dist_pos, dist_digit);
-            if (is_valid_algo4(erroneous_algo4_sub)) {
-                algo4_undetected_substitutions++;
-            }
-            total_substitution_errors++;
+        }
+        counts.substitutions += run.errors_per_number;
+        counts.transpositions += run.errors_per_number;
+    }
+}
 
-            // Test Transposition Errors
-            int erroneous_verhoeff_trans = introduce_transposition_error(valid_verhoeff_num, gen, dist_trans_pos);
-            if (is_valid_verhoeff(erroneous_verhoeff_trans)) {
-                verhoeff_undetected_transpositions++;
-            }
-            int erroneous_algo1_trans = introduce_transposition_error(valid_algo1_num, gen, dist_trans_pos);
-            if (is_valid_algo1(erroneous_algo1_trans)) {
-                algo1_undetected_transpositions++;
-            }
-            int erroneous_algo2_trans = introduce_transposition_error(valid_algo2_num, gen, dist_trans_pos);
-            if (is_valid_algo2(erroneous_algo2_trans)) {
-                algo2_undetected_transpositions++;
-            }
-            int erroneous_algo3_trans = introduce_transposition_error(valid_algo3_num, gen, dist_trans_pos);
-            if (is_valid_algo3(erroneous_algo3_trans)) {
-                algo3_undetected_transpositions++;
-            }
-            int erroneous_algo4_trans = introduce_transposition_error(valid_algo4_num, gen, dist_trans_pos);
-            if (is_valid_algo4(erroneous_algo4_trans)) {
-                algo4_undetected_transpositions++;
-            }
+// Call work(worker, block) for every block on `threads` workers (the calling thread
+// is worker 0) that take the next block until none are left
+template <typename Work>
+void run_blocks(int threads, long long block_count, Work work) {
+    std::atomic<long long> next_block(0);
+    auto worker = [&](int w) {
+        for (long long block = next_block++; block < block_count; block = next_block++) {
+            work(w, block);
+        }
+    };
+    verhoeff_batch_init(); // fill the shared tables before the workers read them
+    std::vector<std::thread> workers;
+    for (int w = 1; w < threads; ++w) {
+        workers.emplace_back(worker, w);
+    }
+    worker(0);
+    for (std::thread &t : workers) {
+        t.join();
+    }
+}
 
-            total_transposition_errors++;
+Detection_counts run_detection(const Detection_run &run) {
+    std::vector<Detection_counts> worker_counts(run.threads);
+    run_blocks(run.threads, (run.valid_numbers + DETECTION_BLOCK_SIZE - 1) / DETECTION_BLOCK_SIZE,
+               [&](int w, long long block) {
+        if (run.threads == 1) {
+            std::cout << "Processing batch " << block + 1 << "...\n";
         }
+        run_detection_block(run, block, worker_counts[w]);
+    });
+
+    Detection_counts total;
+    for (const Detection_counts &counts : worker_counts) {
+        total.merge(counts);
     }
+    return total;
+}
 
+void print_detection_tables(const Detection_counts &counts) {
     std::cout << "\n--- False Positive Results (Error Detection) ---\n";
     std::cout << std::fixed << std::setprecision(5);
 
-    std::cout << "\nTotal Substitution Errors Tested: " << total_substitution_errors << "\n";
+    std::cout << "\nTotal Substitution Errors Tested: " << counts.substitutions << "\n";
     std::cout << "Algorithm                  | Undetected Substitutions | False Positive Rate (%)\n";
     std::cout << "---------------------------------------------------------------------------\n";
-    std::cout << "Verhoeff-Gumm              | " << std::setw(24) << verhoeff_undetected_substitutions << " | "
-              << (static_cast<double>(verhoeff_undetected_substitutions) / total_substitution_errors) * 100 << "\n";
-    std::cout << "Algorithm 1 (Sum)          | " << std::setw(24) << algo1_undetected_substitutions << " | "
-              << (static_cast<double>(algo1_undetected_substitutions) / total_substitution_errors) * 100 << "\n";
-    std::cout << "Algorithm 2 (Sum of Squares)| " << std::setw(24) << algo2_undetected_substitutions << " | "
-              << (static_cast<double>(algo2_undetected_substitutions) / total_substitution_errors) * 100 << "\n";
-    std::cout << "Algorithm 3 (Paired Products)| " << std::setw(24) << algo3_undetected_substitutions << " | "
-              << (static_cast<double>(algo3_undetected_substitutions) / total_substitution_errors) * 100 << "\n";
-    std::cout << "Algorithm 4 (Triple Products)| " << std::setw(24) << algo4_undetected_substitutions << " | "
-              << (static_cast<double>(algo4_undetected_substitutions) / total_substitution_errors) * 100 << "\n";
-
-    std::cout << "\nTotal Transposition Errors Tested: " << total_transposition_errors << "\n";
+    for (int a = 0; a < DETECTION_ALGORITHM_COUNT; ++a) {
+        std::cout << std::left << std::setw(27) << detection_algorithms[a].name << std::right << "| " << std::setw(24) << counts.undetected_substitutions[a] << " | "
+                  << (static_cast<double>(counts.undetected_substitutions[a]) / counts.substitutions) * 100 << "\n";
+    }
+
+    std::cout << "\nTotal Transposition Errors Tested: " << counts.transpositions << "\n";
     std::cout << "Algorithm                  | Undetected Transpositions | False Positive Rate (%)\n";
     std::cout << "-----------------------------------------------------------------------------\n";
-    std::cout << "Verhoeff-Gumm              | " << std::setw(27) << verhoeff_undetected_transpositions << " | "
-              << (static_cast<double>(verhoeff_undetected_transpositions) / total_transposition_errors) * 100 << "\n";
-    std::cout << "Algorithm 1 (Sum)          | " << std::setw(27) << algo1_undetected_transpositions << " | "
-              << (static_cast<double>(algo1_undetected_transpositions) / total_transposition_errors) * 100 << "\n";
-    std::cout << "Algorithm 2 (Sum of Squares)| " << std::setw(27) << algo2_undetected_transpositions << " | "
-              << (static_cast<double>(algo2_undetected_transpositions) / total_transposition_errors) * 100 << "\n";
-    std::cout << "Algorithm 3 (Paired Products)| " << std::setw(27) << algo3_undetected_transpositions << " | "
-              << (static_cast<double>(algo3_undetected_transpositions) / total_transposition_errors) * 100 << "\n";
-    std::cout << "Algorithm 4 (Triple Products)| " << std::setw(27) << algo4_undetected_transpositions << " | "
-              << (static_cast<double>(algo4_undetected_transpositions) / total_transposition_errors) * 100 << "\n";
+    for (int a = 0; a < DETECTION_ALGORITHM_COUNT; ++a) {
+        std::cout << std::left << std::setw(27) << detection_algorithms[a].name << std::right << "| " << std::setw(27) << counts.undetected_transpositions[a] << " | "
+                  << (static_cast<double>(counts.undetected_transpositions[a]) / counts.transpositions) * 100 << "\n";
+    }
+}
+
+// --- Exhaustive Mode ---
+
+enum Error_class { SUBSTITUTION, ADJACENT_TRANSPOSITION, JUMP_TRANSPOSITION, TWIN_ERROR, PHONETIC_ERROR, ERROR_CLASS_COUNT };
+
+static const char *error_class_names[ERROR_CLASS_COUNT] = {
+    "Substitution", "Adjacent transposition", "Jump transposition", "Twin error", "Phonetic error"
+};
+static const char *error_class_keys[ERROR_CLASS_COUNT] = { // names in the JSON and CSV output
+    "substitution", "adjacent_transposition", "jump_transposition", "twin", "phonetic"
+};
+
+// Call report(error_class, erroneous_number) for every single error of a 6-digit number:
+//   substitution            a -> b at any position (6 x 9)
+//   adjacent transposition  ab -> ba with a != b
+//   jump transposition      abc -> cba with a != c
+//   twin error              aa -> bb with a != b
+//   phonetic error          1a <-> a0 with a >= 2 (fifteen / fifty)
+// The erroneous numbers are computed from the digits, nothing is allocated.
+template <typename Report>
+void for_each_error(int number, Report report) {
+    static const int place[6] = {100000, 10000, 1000, 100, 10, 1};
+    int digits[6];
+    get_digits(number, 6, digits);
+    for (int i = 0; i < 6; ++i) {
+        for (int d = 0; d < 10; ++d) {
+            if (d != digits[i]) report(SUBSTITUTION, number + (d - digits[i]) * place[i]);
+        }
+    }
+    for (int i = 0; i + 1 < 6; ++i) {
+        int a = digits[i], b = digits[i + 1];
+        if (a != b) report(ADJACENT_TRANSPOSITION, number + (b - a) * place[i] + (a - b) * place[i + 1]);
+    }
+    for (int i = 0; i + 2 < 6; ++i) {
+        int a = digits[i], c = digits[i + 2];
+        if (a != c) report(JUMP_TRANSPOSITION, number + (c - a) * place[i] + (a - c) * place[i + 2]);
+    }
+    for (int i = 0; i + 1 < 6; ++i) {
+        if (digits[i] != digits[i + 1]) continue;
+        for (int d = 0; d < 10; ++d) {
+            if (d != digits[i]) report(TWIN_ERROR, number + (d - digits[i]) * (place[i] + place[i + 1]));
+        }
+    }
+    for (int i = 0; i + 1 < 6; ++i) {
+        int a = digits[i], b = digits[i + 1];
+        if (a == 1 && b >= 2) {
+            report(PHONETIC_ERROR, number + (b - 1) * place[i] - b * place[i + 1]);
+        } else if (a >= 2 && b == 0) {
+            report(PHONETIC_ERROR, number + (1 - a) * place[i] + a * place[i + 1]);
+        }
+    }
+}
+
+// Errors tested and missed per algorithm and error class
+struct Exhaustive_counts {
+    std::vector<std::array<long long, ERROR_CLASS_COUNT>> tested =
+        std::vector<std::array<long long, ERROR_CLASS_COUNT>>(DETECTION_ALGORITHM_COUNT, std::array<long long, ERROR_CLASS_COUNT>{});
+    std::vector<std::array<long long, ERROR_CLASS_COUNT>> undetected =
+        std::vector<std::array<long long, ERROR_CLASS_COUNT>>(DETECTION_ALGORITHM_COUNT, std::array<long long, ERROR_CLASS_COUNT>{});
+
+    void merge(const Exhaustive_counts &other) {
+        for (int a = 0; a < DETECTION_ALGORITHM_COUNT; ++a) {
+            for (int c = 0; c < ERROR_CLASS_COUNT; ++c) {
+                tested[a][c] += other.tested[a][c];
+                undetected[a][c] += other.undetected[a][c];
+            }
+        }
+    }
+};
+
+// Every error of the valid number of every prefix 10000..99999, for every algorithm
+Exhaustive_counts run_exhaustive(int threads) {
+    const int first_prefix = 10000, prefix_count = 90000, block_size = 1000;
+    std::vector<Exhaustive_counts> worker_counts(threads);
+    run_blocks(threads, prefix_count / block_size, [&](int w, long long block) {
+        Exhaustive_counts &counts = worker_counts[w];
+        for (int prefix = first_prefix + static_cast<int>(block) * block_size;
+             prefix < first_prefix + static_cast<int>(block + 1) * block_size; ++prefix) {
+            for (int a = 0; a < DETECTION_ALGORITHM_COUNT; ++a) {
+                const Detection_algorithm &algorithm = detection_algorithms[a];
+                std::array<long long, ERROR_CLASS_COUNT> &tested = counts.tested[a];
+                std::array<long long, ERROR_CLASS_COUNT> &undetected = counts.undetected[a];
+                for_each_error(prefix * 10 + algorithm.check_digit(prefix), [&](Error_class error, int erroneous) {
+                    tested[error]++;
+                    undetected[error] += algorithm.is_valid(erroneous);
+                });
+            }
+        }
+    });
+
+    Exhaustive_counts total;
+    for (const Exhaustive_counts &counts : worker_counts) {
+        total.merge(counts);
+    }
+    return total;
+}
+
+void print_exhaustive_table(const Exhaustive_counts &counts, const std::vector<Throughput_result> &throughput) {
+    std::cout << "\n--- Detection Matrix (every single error of all 90000 valid numbers) ---\n";
+    std::cout << "Undetected errors / errors tested (undetected %), validation cost in ns per number (median)\n\n";
+    std::cout << std::left << std::setw(30) << "Algorithm";
+    for (int c = 0; c < ERROR_CLASS_COUNT; ++c) {
+        std::cout << "| " << std::setw(31) << error_class_names[c];
+    }
+    std::cout << "| Validate ns" << std::right << "\n" << std::string(30 + 33 * ERROR_CLASS_COUNT + 12, '-') << "\n";
+    for (int a = 0; a < DETECTION_ALGORITHM_COUNT; ++a) {
+        std::cout << std::left << std::setw(30) << detection_algorithms[a].name << std::right;
+        for (int c = 0; c < ERROR_CLASS_COUNT; ++c) {
+            long long tested = counts.tested[a][c], undetected = counts.undetected[a][c];
+            double rate = tested ? static_cast<double>(undetected) / tested * 100 : 0.0;
+            std::cout << "| " << std::setw(8) << undetected << " / " << std::setw(8) << tested
+                      << " (" << std::fixed << std::setprecision(5) << std::setw(9) << rate << ") ";
+        }
+        std::cout << "| " << std::setprecision(2) << std::setw(11) << throughput[a].validate_median << "\n";
+    }
+}
+
+// The matrix as one JSON object: an entry per algorithm with its throughput and its counts per error class
+bool write_exhaustive_json(const std::string &path, const Exhaustive_counts &counts, const std::vector<Throughput_result> &throughput) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << std::fixed << "{\n  \"prefixes\": 90000,\n  \"algorithms\": [\n";
+    for (int a = 0; a < DETECTION_ALGORITHM_COUNT; ++a) {
+        out << "    {\"name\": \"" << detection_algorithms[a].name << "\", "
+            << std::setprecision(3) << "\"generate_ns\": " << throughput[a].generate_median
+            << ", \"validate_ns\": " << throughput[a].validate_median << ", \"errors\": {";
+        for (int c = 0; c < ERROR_CLASS_COUNT; ++c) {
+            long long tested = counts.tested[a][c], undetected = counts.undetected[a][c];
+            out << (c ? ", " : "") << "\"" << error_class_keys[c] << "\": {\"tested\": " << tested
+                << ", \"undetected\": " << undetected << ", \"undetected_percent\": " << std::setprecision(5)
+                << (tested ? static_cast<double>(undetected) / tested * 100 : 0.0) << "}";
+        }
+        out << "}}" << (a + 1 < DETECTION_ALGORITHM_COUNT ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// The matrix as CSV, one row per algorithm and error class
+bool write_exhaustive_csv(const std::string &path, const Exhaustive_counts &counts, const std::vector<Throughput_result> &throughput) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << std::fixed << "algorithm,error_class,tested,undetected,undetected_percent,generate_ns,validate_ns\n";
+    for (int a = 0; a < DETECTION_ALGORITHM_COUNT; ++a) {
+        for (int c = 0; c < ERROR_CLASS_COUNT; ++c) {
+            long long tested = counts.tested[a][c], undetected = counts.undetected[a][c];
+            out << "\"" << detection_algorithms[a].name << "\"," << error_class_keys[c] << "," << tested << ","
+                << undetected << "," << std::setprecision(5) << (tested ? static_cast<double>(undetected) / tested * 100 : 0.0)
+                << "," << std::setprecision(3) << throughput[a].generate_median << "," << throughput[a].validate_median << "\n";
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+void run_throughput(const std::vector<int> &prefixes, int repetitions) {
+    std::cout << "\n--- Throughput (ns per number, median and best of " << repetitions << " passes over "
+              << prefixes.size() << " numbers) ---\n";
+    std::cout << "Algorithm                     | Generate median | Generate best | Validate median | Validate best\n";
+    std::cout << "-------------------------------------------------------------------------------------------------\n";
+    std::cout << std::fixed << std::setprecision(2);
+    long long sink = 0;
+    for (const Detection_algorithm &algorithm : detection_algorithms) {
+        Throughput_result result = algorithm.measure(prefixes, repetitions, sink);
+        std::cout << std::left << std::setw(30) << algorithm.name << std::right << "| "
+                  << std::setw(15) << result.generate_median << " | " << std::setw(13) << result.generate_best << " | "
+                  << std::setw(15) << result.validate_median << " | " << std::setw(13) << result.validate_best << "\n";
+    }
+    std::cout << "(checksum " << sink << ")\n";
+}
+
+void print_usage(const char *program) {
+    std::cout << "Usage: " << program << " [--seed S] [--threads N] [--samples N] [--errors N] [--throughput [--repetitions N]]\n"
+              << "  --seed S     seed of every random choice, the same seed gives the same counts (random by default)\n"
+              << "  --threads N  worker threads, 0 for one per core (1 by default)\n"
+              << "  --samples N  valid numbers to introduce errors into (10000 by default)\n"
+              << "  --errors N   substitution and transposition errors per valid number (50 by default)\n"
+              << "  --exhaustive test every substitution, adjacent and jump transposition, twin and phonetic error of\n"
+              << "               every valid number and time validation, giving one detection matrix\n"
+              << "  --json FILE, --csv FILE  also write the detection matrix of --exhaustive to FILE\n"
+              << "  --throughput time generating and validating check digits instead of counting undetected errors\n"
+              << "  --repetitions N  timed passes per algorithm in throughput mode (5 by default)\n";
+}
+
+int main(int argc, char **argv) {
+    Detection_run run;
+    bool seeded = false;
+    bool throughput = false;
+    bool exhaustive = false;
+    int repetitions = 5;
+    std::string json_path, csv_path;
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--throughput") {
+            throughput = true;
+            continue;
+        }
+        if (option == "--exhaustive") {
+            exhaustive = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--seed") {
+            run.seed = std::stoull(value);
+            seeded = true;
+        } else if (option == "--threads") {
+            run.threads = std::stoi(value);
+        } else if (option == "--samples") {
+            run.valid_numbers = std::stoll(value);
+        } else if (option == "--errors") {
+            run.errors_per_number = std::stoi(value);
+        } else if (option == "--repetitions") {
+            repetitions = std::stoi(value);
+        } else if (option == "--json") {
+            json_path = value;
+        } else if (option == "--csv") {
+            csv_path = value;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!seeded) {
+        std::random_device rd;
+        run.seed = (static_cast<std::uint64_t>(rd()) << 32) | rd();
+    }
+    if (run.threads <= 0) {
+        run.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (run.valid_numbers < 0 || run.errors_per_number < 0 || repetitions <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // To store unique valid prefixes to avoid duplicate testing and ensure randomization
+    for (int i = 10000; i <= 99999; ++i) {
+        run.prefixes.push_back(i);
+    }
+    std::seed_seq seeds{static_cast<std::uint32_t>(run.seed), static_cast<std::uint32_t>(run.seed >> 32)};
+    std::mt19937 gen(seeds);
+    std::shuffle(run.prefixes.begin(), run.prefixes.end(), gen); // Shuffle to pick random prefixes
+
+    if (throughput) {
+        std::cout << "Benchmarking check digit algorithms for throughput...\n";
+        verhoeff_batch_init();
+        run_throughput(run.prefixes, repetitions);
+        return 0;
+    }
+
+    if (exhaustive) {
+        std::cout << "Benchmarking check digit algorithms on every single error, " << run.threads << " thread(s)...\n";
+        auto start = std::chrono::steady_clock::now();
+        Exhaustive_counts counts = run_exhaustive(run.threads);
+        auto end = std::chrono::steady_clock::now();
+
+        // timed on this thread alone, after the workers are done
+        std::vector<Throughput_result> throughput;
+        long long sink = 0;
+        for (const Detection_algorithm &algorithm : detection_algorithms) {
+            throughput.push_back(algorithm.measure(run.prefixes, repetitions, sink));
+        }
+
+        print_exhaustive_table(counts, throughput);
+        std::cout << "\nEnumerated in " << std::setprecision(2)
+                  << std::chrono::duration<double>(end - start).count() << " s (checksum " << sink << ")\n";
+        if (!json_path.empty() && !write_exhaustive_json(json_path, counts, throughput)) {
+            std::cout << "Could not write " << json_path << "\n";
+            return 1;
+        }
+        if (!csv_path.empty() && !write_exhaustive_csv(csv_path, counts, throughput)) {
+            std::cout << "Could not write " << csv_path << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    std::cout << "Benchmarking check digit algorithms for error detection...\n";
+    std::cout << "Seed " << run.seed << ", " << run.threads << " thread(s)\n";
+
+    std::cout << "Generating " << run.valid_numbers << " valid numbers and introducing "
+              << run.errors_per_number << " errors for each...\n";
+
+    print_detection_tables(run_detection(run));
     return 0;
 }